@@ -6,6 +6,9 @@ INC_FLAGS=-I$(ROOT)/include -I$(ROOT)/lib/CImg -I$(ROOT)/lib/libuv/include -I$(R
 
 C_FLAGS= $(INC_FLAGS) -fpermissive $(TP_TYPE)
 
+# Atom on Edison supports SSE2
+C_FLAGS+= -msse2
+
 ifeq ($(Release), 1)
 C_FLAGS +=-O2 
 else
@@ -2,6 +2,7 @@
 DEF_INT(CONFIG_REVERSE_Y, "reverse_y", int,   0         , "whether reverse touch panel input's y-axis")
 
 DEF_STR(CONFIG_FONT,           "font",              char*, "msyh.ttf",   "font path")
+DEF_STR(CONFIG_FONT_PACK,      "font_pack",         char*, "",           "precompiled font pack path")
 DEF_STR(CONFIG_PLAYER,	       "player",            char*, "no player", "player name")
 DEF_STR(CONFIG_PLAYER_OPTION,  "player_option",     char*, "no options", "player options name")
 DEF_STR(CONFIG_VOL_CONTROL,	   "vol_control",       char*, "no vol control", "control playback volumne")
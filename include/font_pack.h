@@ -0,0 +1,40 @@
+#ifndef MUG_FONT_PACK_H
+#define MUG_FONT_PACK_H
+
+#include <stdint.h>
+
+/*
+ precompiled font pack, all fields little endian
+
+   font_pack_header_t
+   font_pack_glyph_t[count]   sorted by code
+   bitmaps                    1 bit per pixel, msb first, rows padded to bytes
+ */
+
+#define FONT_PACK_MAGIC   0x544e464d  // "MFNT"
+#define FONT_PACK_VERSION 1
+
+typedef struct __attribute__((packed)) _font_pack_header_t {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t height;    // pixel size glyphs were rendered with
+  uint32_t count;
+} font_pack_header_t;
+
+typedef struct __attribute__((packed)) _font_pack_glyph_t {
+  uint32_t code;
+  uint8_t  width;
+  uint8_t  rows;
+  uint16_t reserved;
+  uint32_t offset;    // from start of file
+} font_pack_glyph_t;
+
+#define FONT_PACK_PITCH(w) (((w) + 7) / 8)
+
+int                      font_pack_open(const char *path);
+void                     font_pack_close();
+int                      font_pack_height();
+const font_pack_glyph_t* font_pack_find(uint32_t code);
+const unsigned char*     font_pack_bitmap(const font_pack_glyph_t *glyph);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef MUG_FRAME_SCHED_H
+#define MUG_FRAME_SCHED_H
+
+#include <time.h>
+#include <mug.h>
+
+// paces frames on absolute CLOCK_MONOTONIC deadlines
+typedef struct _frame_sched_t {
+  struct timespec start;
+  long long       interval;   // ns
+  long long       frame;      // index of the next frame
+  long long       jitter_sum; // us
+  disp_stat_t     stat;
+} frame_sched_t;
+
+void sched_init(frame_sched_t *s, int interval);
+void sched_init_ns(frame_sched_t *s, long long interval);
+bool sched_next(frame_sched_t *s);
+void sched_finish(frame_sched_t *s, bool hold = true);
+
+#endif
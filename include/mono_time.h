@@ -0,0 +1,25 @@
+#ifndef MUG_MONO_TIME_H
+#define MUG_MONO_TIME_H
+
+#include <time.h>
+
+// CLOCK_MONOTONIC, the clock of frame deadlines, sample stamps and evdev events
+
+static inline long long now_ns()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static inline long long now_us()
+{
+  return now_ns() / 1000;
+}
+
+static inline long long now_ms()
+{
+  return now_ns() / 1000000;
+}
+
+#endif
@@ -37,6 +37,13 @@
 #define MQ_EPILOG   0x2
 #define MQ_ALL      0x3
 
+// batched frame buffer transfer
+//   cmd FB_BATCH_CMD, payload: row_mask[2] (little endian, bit n = row n),
+//   reserved, then 8 bytes for each row of row_mask in ascending order
+#define FB_BATCH_CMD     8
+#define FB_BATCH_HEADER  3
+#define FB_BATCH_ROWS    ((32 - FB_BATCH_HEADER) / MAX_COMPRESSED_COLS)
+
 typedef long handle_t;
 
 #ifndef _LIBIOHUB_H_
@@ -113,6 +120,24 @@ typedef void (*gesture_cb_t)(gesture_t, char*); //gesture, info
 typedef void (*touch_cb_t)(int, int, int); // x, y, id
 typedef void (*touch_event_cb_t)(touch_event_t, int, int, int); // event, x, y, id
 
+typedef struct _gesture_stat_t
+{
+  int count;        // gestures recognized
+  int avg_latency;  // us from the sample that completed the gesture to recognition
+  int max_latency;  // us
+  int avg_duration; // ms from touch down to recognition
+  int max_duration; // ms
+} gesture_stat_t;
+
+typedef struct _touch_stat_t
+{
+  int events;       // input_events read
+  int callbacks;    // callbacks run
+  int p50_latency;  // us from kernel timestamp to callback
+  int p99_latency;  // us
+  int max_latency;  // us
+} touch_stat_t;
+
 extern unsigned char red[3];
 extern unsigned char green[3];
 extern unsigned char blue[3];
@@ -122,6 +147,20 @@ extern unsigned char magenta[3];
 extern unsigned char white[3];
 extern unsigned char black[3];
 
+// sprite in packed format, pixel x of a row at bits 4x, mask 0xf if opaque
+typedef struct _mug_sprite_t
+{
+  int      width, height;
+  uint64_t row[MAX_ROWS];
+  uint64_t mask[MAX_ROWS];
+} mug_sprite_t;
+
+// frame buffer drawn directly in the packed display format
+typedef struct _mug_canvas_t
+{
+  char raw[COMPRESSED_SIZE];
+} mug_canvas_t;
+
 typedef enum {
   RED,
   GREEN,
@@ -140,6 +179,18 @@ extern "C" {
 typedef int mug_error_t;
 
 #define MUG_ERROR_NONE 0
+#define MUG_ERROR_INVALID_ARG -4
+
+// timing of the last paced animation
+typedef struct _disp_stat_t
+{
+  int frames;     // frames shown
+  int dropped;    // frames skipped after missing their slot
+  int avg_jitter; // us
+  int max_jitter; // us
+} disp_stat_t;
+
+typedef mug_error_t (*disp_transport_t)(handle_t, int, char*, int); // handle, cmd, data, length
 
 // device control
 handle_t mug_init(device_t type);
@@ -150,8 +201,19 @@ void     mug_shut_down_mcu(int sec);
 handle_t     mug_disp_init();
 mug_error_t  mug_disp_raw(handle_t handle, char* imgData);
 mug_error_t  mug_disp_raw_N(handle_t handle, char* imgData, int number, int interval);
+int          mug_disp_rows_sent(handle_t handle); // rows sent by the last mug_disp_raw
+int          mug_disp_set_batch(handle_t handle, int enable); // -1 if iohubd would have to route it
+void         mug_disp_set_transport(disp_transport_t transport); // NULL for i2c
+void         mug_disp_invalidate(handle_t handle); // the next frame of any process is sent in full
+void         mug_disp_get_stat(handle_t handle, disp_stat_t *stat);
 void         mug_stop_mcu_disp(handle_t handle);
 
+// animation stored and played by mcu, up to 100 frames; durations in ms,
+// NULL plays every frame for 100ms. not available through iohubd
+mug_error_t  mug_upload_animation(handle_t handle, char *raw, int number, int *durations);
+mug_error_t  mug_play_uploaded(handle_t handle);
+mug_error_t  mug_stop_uploaded(handle_t handle);
+
 // raw image buffer
 char* mug_create_raw_buffer();
 void  mug_free_raw_buffer(char *buf);
@@ -177,8 +239,11 @@ typedef unsigned long cimg_handle_t;
 
 // cimg
 int   mug_cimg_to_raw(cimg_handle_t cimg, char *buf);
+int   mug_cimg_to_raw_N(cimg_handle_t *cimgs, int num, char *buf);
 int   mug_disp_cimg(handle_t handle, cimg_handle_t cimg); 
 void  mug_number_text_shape(int *width, int *height);
+void  mug_draw_number_str_raw(char *raw, int col, int row, const char *str, const char* color);
+int   mug_draw_text_raw(char *raw, int col, int row, const char* text, const char* color, int height); // returns width
 
 // cimg handle
 
@@ -197,6 +262,18 @@ void           mug_disp_cimg_marquee_async(handle_t handle, cimg_handle_t img, i
 void           mug_stop_marquee(handle_t handle);
 
 cimg_handle_t  mug_new_text_cimg(const char* text, const char* color);
+int            mug_cimg_to_sprite(cimg_handle_t cimg, mug_sprite_t *sprite); // black is transparent
+
+// packed canvas, every color is a raw color from color_2_raw
+void        mug_canvas_fill(mug_canvas_t *canvas, unsigned char color);
+void        mug_canvas_pixel(mug_canvas_t *canvas, int col, int row, unsigned char color);
+void        mug_canvas_rect(mug_canvas_t *canvas, int col, int row, int width, int height, unsigned char color, int filled);
+void        mug_canvas_line(mug_canvas_t *canvas, int col0, int row0, int col1, int row1, unsigned char color);
+void        mug_canvas_blit(mug_canvas_t *canvas, int col, int row, const mug_canvas_t *src, int src_col, int src_row, int width, int height);
+void        mug_canvas_sprite(mug_canvas_t *canvas, int col, int row, const mug_sprite_t *sprite);
+void        mug_canvas_number(mug_canvas_t *canvas, int col, int row, const char *str, unsigned char color);
+int         mug_canvas_text(mug_canvas_t *canvas, int col, int row, const char *text, unsigned char color);
+mug_error_t mug_canvas_present(handle_t handle, mug_canvas_t *canvas);
 
 // motion sensor
 typedef struct _MPU6050 motion_data_t;
@@ -204,6 +281,14 @@ typedef void (*motion_cb_t)(int, int, int, int, int, int);
 typedef void (*motion_angel_cb_t)(float, float, float);
 typedef void (*motion_shake_cb_t)(int);
 
+typedef struct _motion_sample_t
+{
+  motion_data_t data;
+  long long     stamp;   // us, CLOCK_MONOTONIC
+} motion_sample_t;
+
+typedef void (*motion_batch_cb_t)(motion_sample_t*, int); // samples, count
+
 handle_t     mug_motion_init();
 mug_error_t  mug_read_motion(handle_t handle, motion_data_t *data);
 void         mug_motion_on(handle_t handle, motion_cb_t cb);
@@ -211,14 +296,66 @@ void         mug_motion_angle_on(handle_t handle, motion_angel_cb_t acb);
 void         mug_set_motion_timer(handle_t handle, int interval);
 void         mug_motion_shake_on(handle_t handle, motion_shake_cb_t scb);
 void         mug_config_shake(handle_t handle, int period, int times);
+// ms without shaking before shake stop is reported
+void         mug_config_shake_release(handle_t handle, int release);
+// sample at rate Hz on a reader thread, cb gets up to max_batch samples
+// at once and no sample waits longer than max_latency ms
+void         mug_motion_batch_on(handle_t handle, motion_batch_cb_t cb, int max_batch, int max_latency);
+// stop the reader and drop undelivered samples, call on the motion loop's thread
+void         mug_motion_batch_off(handle_t handle);
+void         mug_set_motion_rate(handle_t handle, int rate);
+// samples lost because the batch callback fell behind
+unsigned int mug_motion_dropped(handle_t handle);
 void         mug_run_motion_watcher(handle_t handle);
 
+// sensor fusion (Mahony filter), one object per independent attitude
+typedef struct _mug_fusion_t
+{
+  float q[4];            // attitude quaternion w, x, y, z
+  float integral[3];     // integral feedback, rad/s
+  float kp, ki;          // feedback gains
+  float gyro_offset[3];  // raw gyro bias
+  float gyro_scale;      // raw gyro to rad/s
+} mug_fusion_t;
+
+typedef struct _mug_attitude_t
+{
+  float q[4];
+  float roll, pitch, yaw; // degrees
+} mug_attitude_t;
+
+void         mug_fusion_init(mug_fusion_t *f);
+// feed n samples taken dt seconds apart, out gets one attitude per sample if not NULL
+void         mug_fusion_update(mug_fusion_t *f, const motion_data_t *samples, int n, float dt, mug_attitude_t *out);
+void         mug_fusion_attitude(const mug_fusion_t *f, mug_attitude_t *out);
+
 
 typedef void (*temp_cb_t)(int, int);
 typedef void (*battery_cb_t)(int, int);
 
+// latest adc reading, shared by every process on the mug
+typedef struct _adc_sample_t
+{
+  uint16_t  mug_temp;    // 10 bit adc codes
+  uint16_t  board_temp;
+  uint16_t  battery;
+  uint16_t  charging;    // 1 while the charger is plugged in
+  long long stamp;       // us, CLOCK_MONOTONIC
+} adc_sample_t;
+
+// returned by mug_read_*_temp and mug_read_battery when the bus read fails
+#define MUG_ADC_ERROR (-0x8000)
+
 // adc
 handle_t    mug_adc_init();
+mug_error_t mug_adc_sample(handle_t handle, adc_sample_t *sample);
+// ms a sample is reused before the bus is read again, default 100
+void        mug_config_adc_period(handle_t handle, int period);
+// take samples (up to 16) per watcher interval and report the median/iir filtered
+// values only when they move past the deadbands; 0 samples reports every reading.
+// samples are at least the adc period apart, so a short interval is stretched to
+// samples * period. applies to watchers started afterwards
+void        mug_config_adc_filter(handle_t handle, int samples, int temp_deadband, int battery_deadband);
 int         mug_adc_on(handle_t handle, temp_cb_t temp_cb, battery_cb_t battery_cb, int interval);
 void        mug_run_adc_watcher(handle_t handle);
 
@@ -233,18 +370,29 @@ void        mug_run_temp_watcher(handle_t handle);
 handle_t    mug_battery_init();
 int         mug_read_battery(handle_t handle, bool *is_charge);
 int         mug_battery_on(handle_t handle, battery_cb_t cb, int interval);
+// smooth the percent with time constant tau ms, 0 (default) reports the raw table value
+void        mug_battery_smooth(handle_t handle, int tau);
 void        mug_run_battery_watcher(handle_t handle);
 
 
 
 // touch panel
 handle_t  mug_touch_init();
+// read input_events from fd instead of scanning for the panel, e.g. a replay pipe
+handle_t  mug_touch_init_fd(int fd);
 void      mug_touch_on(handle_t handle, touch_cb_t cb);
 void      mug_gesture_on(handle_t handle, gesture_t g, gesture_cb_t cb);
 void      mug_touch_event_on(handle_t handle, touch_event_t event, touch_event_cb_t cb);
 void      mug_run_touch_thread(handle_t handle);
 void      mug_stop_touch_thread(handle_t handle);
 void      mug_wait_for_touch_thread(handle_t handle);
+// callbacks dropped because the dispatch queue was full
+unsigned int mug_touch_dropped(handle_t handle);
+void      mug_gesture_get_stat(handle_t handle, gesture_t g, gesture_stat_t *stat);
+void      mug_touch_get_stat(handle_t handle, touch_stat_t *stat);
+void      mug_touch_reset_stat(handle_t handle);
+// save raw events to path in touch_rec.h format, NULL stops recording
+int       mug_touch_record(handle_t handle, const char *path);
 
 // configuration
 int         mug_query_config_int(const char *key);
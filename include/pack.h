@@ -0,0 +1,45 @@
+#ifndef MUG_PACK_H
+#define MUG_PACK_H
+
+#include <string.h>
+#include <mug.h>
+
+// a colour channel above this lights the led, shared by every path that
+// thresholds pixels (rgb_2_raw, the pack kernel, glyphs, font packs)
+#define LATCH 80
+
+// threshold planar R/G/B rows into the packed 4-bit display format,
+// one SCREEN_WIDTH x SCREEN_HEIGHT frame starting at r/g/b
+void pack_rgb_frame(const unsigned char *r, const unsigned char *g, const unsigned char *b,
+                    int stride, char *buf);
+
+// a packed display row is one little endian 64 bit word, pixel x at bits 4x
+static inline uint64_t raw_get_row(const char *raw, int row)
+{
+  uint64_t line;
+  memcpy(&line, raw + row * MAX_COMPRESSED_COLS, sizeof(line));
+  return line;
+}
+
+static inline void raw_set_row(char *raw, int row, uint64_t line)
+{
+  memcpy(raw + row * MAX_COMPRESSED_COLS, &line, sizeof(line));
+}
+
+// nibble mask for pixels [0, width)
+static inline uint64_t raw_width_mask(int width)
+{
+  return width >= MAX_COLS ? ~0ULL : ((1ULL << (4 * width)) - 1);
+}
+
+// a raw color as rgb with every lit channel at full intensity
+void raw_2_rgb(unsigned char raw, unsigned char rgb[3]);
+
+// number pictures and text in rgb, drawn into a packed buffer
+void draw_number_raw(char *raw, int col, int row, const char *str, unsigned char *color);
+int  draw_text_raw(char *raw, int col, int row, const char* text, unsigned char *rgb, int height);
+
+void raw_put_bits(char *raw, int col, int row, uint64_t bits, uint64_t mask);
+void raw_draw_sprite(char *raw, int col, int row, const mug_sprite_t *sprite);
+
+#endif
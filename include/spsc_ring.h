@@ -0,0 +1,65 @@
+#ifndef MUG_SPSC_RING_H
+#define MUG_SPSC_RING_H
+
+#define CACHE_LINE 64
+
+// single-producer/single-consumer ring of POD items, SIZE a power of 2.
+// head and tail on their own cache lines so producer and consumer
+// don't bounce each other's line
+template <typename T, unsigned int SIZE>
+struct spsc_ring_t {
+  unsigned int head __attribute__((aligned(CACHE_LINE)));
+  unsigned int tail __attribute__((aligned(CACHE_LINE)));
+  unsigned int overflow __attribute__((aligned(CACHE_LINE)));
+  T            items[SIZE];
+};
+
+// producer side, drops the item if the consumer is a whole ring behind
+template <typename T, unsigned int SIZE>
+static inline bool ring_push(spsc_ring_t<T, SIZE> *ring, const T *item)
+{
+  unsigned int head = ring->head;
+  unsigned int tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+  if(head - tail >= SIZE) {
+    __sync_fetch_and_add(&ring->overflow, 1);
+    return false;
+  }
+
+  ring->items[head & (SIZE - 1)] = *item;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+  return true;
+}
+
+// consumer side, pops up to max items
+template <typename T, unsigned int SIZE>
+static inline int ring_pop(spsc_ring_t<T, SIZE> *ring, T *out, int max)
+{
+  unsigned int tail = ring->tail;
+  unsigned int head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  int n = 0;
+
+  while(tail != head && n < max)
+    out[n++] = ring->items[tail++ & (SIZE - 1)];
+
+  __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+  return n;
+}
+
+// consumer side, drops whatever is queued
+template <typename T, unsigned int SIZE>
+static inline void ring_clear(spsc_ring_t<T, SIZE> *ring)
+{
+  __atomic_store_n(&ring->tail, __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+// items dropped by ring_push so far
+template <typename T, unsigned int SIZE>
+static inline unsigned int ring_overflow(spsc_ring_t<T, SIZE> *ring)
+{
+  return __atomic_load_n(&ring->overflow, __ATOMIC_RELAXED);
+}
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef MUG_TOUCH_REC_H
+#define MUG_TOUCH_REC_H
+
+#include <stdint.h>
+
+/*
+ recorded touch session, native byte order
+
+   touch_rec_header_t
+   struct input_event[]   as read from the panel, CLOCK_MONOTONIC timestamps
+ */
+
+#define TOUCH_REC_MAGIC   0x4345524d  // "MREC"
+#define TOUCH_REC_VERSION 1
+
+typedef struct __attribute__((packed)) _touch_rec_header_t {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t event_size;  // sizeof(struct input_event) of the recorder
+} touch_rec_header_t;
+
+#endif
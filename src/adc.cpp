@@ -4,12 +4,19 @@
 #include <stdlib.h>
 #include <iohub_client.h>
 #include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
 #include <mug.h>
 #include <RTC.h>
 
 #include <config.h>
+#include <mono_time.h>
 
 #include <list>
+#include <algorithm>
 using namespace std;
 
 #ifndef USE_IOHUB
@@ -28,10 +35,44 @@ typedef struct _V2P_t {
   int adc;
 }V2P_t;
 
-typedef list<V2P_t> v2p_table_t;
-
-static v2p_table_t v2p_charging;
-static v2p_table_t v2p_discharging;
+#define V2P_MAX 64
+
+// rows sorted by ascending voltage
+typedef struct _v2p_table_t {
+  int   count;
+  V2P_t rows[V2P_MAX];
+} v2p_table_t;
+
+// both tables as compiled by the first process that loads them, kept in
+// shared memory so the others skip parsing while the files are unchanged
+#define BATTERY_SHM_NAME     "/mug_battery_model"
+#define LOCK_BATTERY_MODEL   "/tmp/smart_mug_battery_model"
+#define BATTERY_MODEL_MAGIC  0x54414256 // "VBAT"
+
+#define BATTERY_PATH_MAX 256
+
+typedef struct _battery_model_t {
+  uint32_t    magic;
+  char        charging_path[BATTERY_PATH_MAX];
+  char        discharging_path[BATTERY_PATH_MAX];
+  time_t      charging_mtime;
+  time_t      discharging_mtime;
+  v2p_table_t charging;
+  v2p_table_t discharging;
+} battery_model_t;
+
+static battery_model_t battery_model;
+
+// exponential smoothing of the reported percent, tau in ms, 0 is off
+typedef struct _battery_filter_t {
+  int       tau;
+  bool      valid;
+  bool      charging;
+  float     percent;
+  long long stamp;      // ms
+} battery_filter_t;
+
+static battery_filter_t battery_filter;
 
 // temperature adjustment table
 
@@ -50,27 +91,78 @@ static temp_adjust_table_t temp_adjust_table;
 
 typedef int16_t adc_raw_t[3];
 
+// oversampling and deadband, copied into each watcher when it starts
+typedef struct _adc_filter_t {
+  int samples;            // per period, 0 reports every raw sample
+  int temp_deadband;      // degrees
+  int battery_deadband;   // percent
+} adc_filter_t;
+
+static adc_filter_t adc_filter = {0, 0, 0};
+
+#define ADC_OVERSAMPLE_MAX 16
+#define ADC_IIR_SHIFT      2   // each period's median moves the value by 1/4
+
+typedef struct _adc_channel_t {
+  int16_t window[ADC_OVERSAMPLE_MAX];
+  float   value;          // iir of the window medians, in adc codes
+} adc_channel_t;
+
 typedef struct _req_temp_t {
   handle_t  handle;
   temp_cb_t temp_cb;
   battery_cb_t battery_cb;
+
+  adc_filter_t  filter;
+  int           count;    // samples in the current window
+  int           charging; // samples with the charger on
+  bool          primed;
+  long long     stamp;    // the last reading taken into the window
+  adc_channel_t channel[TEMP_NUM];
+
+  bool          temp_reported, battery_reported;
+  int           mug_temp, board_temp, percent, is_charging;
+
+  int           interval; // ms between samples
+  uint64_t      due;      // loop time of the next sample
 } req_temp_t;
 
+// every watcher shares temp_timer, which ticks at the gcd of their
+// intervals and reads the bus once for all that are due
+typedef list<req_temp_t*> adc_watchers_t;
+static adc_watchers_t adc_watchers;
+static int            adc_tick = 0;
+
 #endif
 
 
 
-int R_to_T(float r) 
+#define ADC_CODES 1024
+
+// adjusted temperature of every 10 bit adc code, built once
+static int16_t code_to_temp[ADC_CODES];
+static bool    temp_lut_ready = false;
+
+// the row whose range holds r, otherwise (in the gaps between rows)
+// interpolated between the nominal resistances, clamped at the ends
+float R_to_T(float r) 
 {
-  RT_t *rt;
+  RT_t *rt = RT_table;
+
   for(int i = 0; i < RT_table_len; i++) {
-    rt = &(RT_table[i]);
-    if(rt->rmin <= r && r <= rt->rmax)
-      return rt->temp;
+    if(rt[i].rmin <= r && r <= rt[i].rmax)
+      return rt[i].temp;
   }
 
-  MUG_ASSERT(false, "can not calculate temperature\n");
+  if(r >= rt[0].rnor)
+    return rt[0].temp;
 
+  for(int i = 1; i < RT_table_len; i++) {
+    if(r >= rt[i].rnor)
+      return rt[i - 1].temp + (rt[i - 1].rnor - r) / (rt[i - 1].rnor - rt[i].rnor) * (rt[i].temp - rt[i - 1].temp);
+  }
+
+  return rt[RT_table_len - 1].temp;
 }
 
 float V_to_R(float v)
@@ -78,11 +170,10 @@ float V_to_R(float v)
   return 10.0 * v /(3.3 - v);
 }
 
-int V_to_T(float v)
+float V_to_T(float v)
 {
   float r = V_to_R(v);
-  int t = R_to_T(r);
-  return t;
+  return R_to_T(r);
 }
 
 handle_t mug_adc_init()
@@ -90,26 +181,160 @@ handle_t mug_adc_init()
   return mug_init(DEVICE_LED);
 }
 
-void read_battery_table(v2p_table_t *table, char *type)
+static bool v2p_less(const V2P_t &a, const V2P_t &b)
+{
+  return a.v < b.v;
+}
+
+static time_t file_mtime(const char *path)
 {
-  char* t = mug_query_config_string(type);
+  struct stat st;
+  MUG_ASSERT(stat(path, &st) == 0, "can not stat battery table: %s\n", path);
+  return st.st_mtime;
+}
+
+static const char* battery_table_path(const char *type)
+{
+  const char* t = mug_query_config_string(type);
   
   MUG_ASSERT(!(t == NULL || strlen(t) == 0), "can not find %s\n", type);
 
+  return t;
+}
+
+// NULL if table_percent can use it: rows sorted by strictly increasing
+// voltage, percent following voltage
+static const char* check_battery_table(const v2p_table_t *table)
+{
+  if(table->count <= 0 || table->count > V2P_MAX)
+    return "bad row count";
+
+  for(int i = 0; i < table->count; i++) {
+    const V2P_t *r = &table->rows[i];
+
+    if(r->percent < 0 || r->percent > 100 || r->v <= 0)
+      return "bad row";
+
+    if(i > 0 && r->v <= r[-1].v)
+      return "duplicated voltage";
+
+    if(i > 0 && r->percent < r[-1].percent)
+      return "percent drops as voltage rises";
+  }
+
+  return NULL;
+}
+
+void read_battery_table(v2p_table_t *table, const char *t)
+{
   FILE *fp = fopen(t, "r");
   MUG_ASSERT(fp != NULL, "can not open battery table: %s\n", t);
   
   V2P_t v2p;
-  while(!feof(fp)) {
-    fscanf(fp, "%d %d %d", &(v2p.percent), &(v2p.v), &(v2p.adc));
-    table->push_back(v2p);
+
+  table->count = 0;
+  while(fscanf(fp, "%d %d %d", &(v2p.percent), &(v2p.v), &(v2p.adc)) == 3) {
+    MUG_ASSERT(table->count < V2P_MAX, "more than %d rows in battery table: %s\n", V2P_MAX, t);
+    table->rows[table->count++] = v2p;
+  }
+
+  MUG_ASSERT(feof(fp), "bad row %d in battery table: %s\n", table->count + 1, t);
+  fclose(fp);
+
+  sort(table->rows, table->rows + table->count, v2p_less);
+
+  const char *err = check_battery_table(table);
+  MUG_ASSERT(err == NULL, "%s in battery table: %s\n", err, t);
+}
+
+// a segment every mug process can map, NULL if there is none
+static void* map_shared(const char *name, size_t size)
+{
+  int fd = shm_open(name, O_RDWR | O_CREAT, 0666);
+  if(fd < 0)
+    return NULL;
+
+  if(ftruncate(fd, size) == -1) {
+    close(fd);
+    return NULL;
   }
+
+  void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  return p == MAP_FAILED ? NULL : p;
+}
+
+static bool same_source(const battery_model_t *m, const char *charge, time_t charge_mtime,
+                        const char *discharge, time_t discharge_mtime)
+{
+  return m->magic == BATTERY_MODEL_MAGIC
+         && strncmp(m->charging_path, charge, BATTERY_PATH_MAX) == 0
+         && strncmp(m->discharging_path, discharge, BATTERY_PATH_MAX) == 0
+         && m->charging_mtime == charge_mtime
+         && m->discharging_mtime == discharge_mtime;
 }
 
 void init_battery_table()
 {
-  read_battery_table(&v2p_charging,    CONFIG_CHARGE_TABLE);
-  read_battery_table(&v2p_discharging, CONFIG_DISCHARGE_TABLE);
+  const char *charge    = battery_table_path(CONFIG_CHARGE_TABLE);
+  const char *discharge = battery_table_path(CONFIG_DISCHARGE_TABLE);
+
+  time_t charge_mtime    = file_mtime(charge);
+  time_t discharge_mtime = file_mtime(discharge);
+
+  static battery_model_t *shared = NULL;
+  if(shared == NULL)
+    shared = (battery_model_t*)map_shared(BATTERY_SHM_NAME, sizeof(battery_model_t));
+
+  // paths that do not fit can not be compared, keep those private
+  bool share = shared != NULL
+               && strlen(charge) < BATTERY_PATH_MAX
+               && strlen(discharge) < BATTERY_PATH_MAX;
+
+  int lock = -1;
+  if(share) {
+    lock = open(LOCK_BATTERY_MODEL, O_RDWR | O_CREAT, 0666);
+    if(lock != -1)
+      lockf(lock, F_LOCK, 0);
+  }
+
+  // lookups use a private copy so a reload elsewhere never tears it, and
+  // the segment is world writable, so the copy is checked before use
+  bool fresh = false;
+  if(share) {
+    battery_model = *shared;
+    fresh = same_source(&battery_model, charge, charge_mtime, discharge, discharge_mtime)
+            && check_battery_table(&battery_model.charging) == NULL
+            && check_battery_table(&battery_model.discharging) == NULL;
+  }
+
+  if(!fresh) {
+    memset(&battery_model, 0, sizeof(battery_model));
+    read_battery_table(&battery_model.charging,    charge);
+    read_battery_table(&battery_model.discharging, discharge);
+    strncpy(battery_model.charging_path, charge, BATTERY_PATH_MAX - 1);
+    strncpy(battery_model.discharging_path, discharge, BATTERY_PATH_MAX - 1);
+    battery_model.charging_mtime    = charge_mtime;
+    battery_model.discharging_mtime = discharge_mtime;
+    battery_model.magic = BATTERY_MODEL_MAGIC;
+
+    if(share) {
+      shared->magic = 0;
+      __sync_synchronize();
+      memcpy((char*)shared + sizeof(uint32_t), (char*)&battery_model + sizeof(uint32_t),
+             sizeof(battery_model_t) - sizeof(uint32_t));
+      __sync_synchronize();
+      shared->magic = BATTERY_MODEL_MAGIC;
+    }
+  }
+
+  if(lock != -1) {
+    lockf(lock, F_ULOCK, 0);
+    close(lock);
+  }
+
+  battery_filter.valid = false;
 }
 
 handle_t mug_battery_init()
@@ -128,10 +353,15 @@ void init_temp_adjust_table()
 
   temp_adjust_t item;
 
-  while(!feof(fp)) {
-    fscanf(fp, "%d %d", &(item.temp), &(item.adjust));
+  temp_adjust_table.clear();
+  while(fscanf(fp, "%d %d", &(item.temp), &(item.adjust)) == 2) {
     temp_adjust_table.push_back(item);
   }    
+
+  fclose(fp);
+
+  // the table changes every code's result
+  temp_lut_ready = false;
 }
 
 handle_t mug_temp_init()
@@ -140,16 +370,8 @@ handle_t mug_temp_init()
   return mug_init(DEVICE_LED);
 }
 
-int voltage_to_temp(uint16_t data)
+int adjust_temp(int temp)
 {
-#if 0
-  float voltage = data * 3.3 / 1024;
-  float tempf = 4050.0/(logf(0.213 * voltage / (3.3 - 2 * voltage)) + 13.59) - 273; 
-  return (int)tempf;
-#else
-  float voltage = data * 3.3 / 1024;
-  int temp = V_to_T(voltage);
-
   if(temp_adjust_table.size() == 0)
     return temp;
 
@@ -171,43 +393,96 @@ int voltage_to_temp(uint16_t data)
   }
 
   return temp + last.adjust;
+}
 
-#endif
-  
+void build_temp_lut()
+{
+  for(int code = 0; code < ADC_CODES; code++) {
+    float voltage = code * 3.3 / ADC_CODES;
+    code_to_temp[code] = adjust_temp((int)lroundf(V_to_T(voltage)));
+  }
+
+  temp_lut_ready = true;
 }
 
-int voltage_to_percent(uint16_t data, bool *is_charging)
+int voltage_to_temp(uint16_t data)
 {
-  V2P_t v2p, last;
+  if(!temp_lut_ready)
+    build_temp_lut();
 
-  *is_charging = ((data & 0x8000) != 0);
-  //int voltage = ((float)(data & 0x3f0)) * 3.0 * 1000 * 3 / (1024 * 2); 
-  int voltage = ((float)(data & 0x3ff)) * 3.0 * 1000 * 3 / (1024 * 2); 
+  return code_to_temp[data & (ADC_CODES - 1)];
+}
+
+// first row at or above voltage, interpolated with the one below it
+int table_percent(const v2p_table_t *table, int voltage)
+{
+  MUG_ASSERT(table->count != 0, "Null battery voltage table\n");
 
-  v2p_table_t *table;
+  const V2P_t *rows = table->rows;
+  int lo = 0, hi = table->count;
 
-  if(*is_charging) {
-    table = &v2p_charging;
-  } else {
-    table = &v2p_discharging;
+  while(lo < hi) {
+    int mid = (lo + hi) / 2;
+    if(rows[mid].v < voltage)
+      lo = mid + 1;
+    else
+      hi = mid;
   }
 
-  MUG_ASSERT(table->size() != 0, "Null battery voltage table\n");
+  if(lo == 0)
+    return rows[0].percent;
 
-  last = table->front();
+  if(lo == table->count)
+    return rows[table->count - 1].percent;
 
-  for(v2p_table_t::iterator itr = table->begin();
-      itr != table->end();
-      itr++) {
+  const V2P_t *a = &rows[lo - 1], *b = &rows[lo];
+
+  return a->percent + ((voltage - a->v) * (b->percent - a->percent) + (b->v - a->v) / 2) / (b->v - a->v);
+}
 
-    v2p = *itr;
-    if(voltage > v2p.v) 
-      return last.percent;
+// the charge only moves one way while the charger state holds, so the
+// smoothed value never steps against it; a plug or unplug starts over
+int smooth_percent(int percent, bool is_charging)
+{
+  battery_filter_t *f = &battery_filter;
+
+  if(f->tau <= 0)
+    return percent;
+
+  long long stamp = now_ms();
 
-    last = v2p;
+  if(!f->valid || f->charging != is_charging) {
+    f->valid    = true;
+    f->charging = is_charging;
+    f->percent  = percent;
+    f->stamp    = stamp;
+    return percent;
   }
 
-  return last.percent;
+  float dt = stamp - f->stamp;
+  float p = f->percent + (percent - f->percent) * dt / (f->tau + dt);
+
+  f->percent = is_charging ? max(f->percent, p) : min(f->percent, p);
+  f->stamp   = stamp;
+
+  return (int)lroundf(f->percent);
+}
+
+int voltage_to_percent(uint16_t data, bool *is_charging)
+{
+  *is_charging = ((data & 0x8000) != 0);
+  //int voltage = ((float)(data & 0x3f0)) * 3.0 * 1000 * 3 / (1024 * 2); 
+  int voltage = ((float)(data & 0x3ff)) * 3.0 * 1000 * 3 / (1024 * 2); 
+
+  const v2p_table_t *table = *is_charging ? &battery_model.charging : &battery_model.discharging;
+
+  return smooth_percent(table_percent(table, voltage), *is_charging);
+}
+
+void mug_battery_smooth(handle_t handle, int tau)
+{
+  battery_filter.tau   = tau;
+  battery_filter.valid = false;
 }
 
 mug_error_t mug_read_adc(handle_t handle, adc_raw_t *data)
@@ -223,52 +498,326 @@ mug_error_t mug_read_adc(handle_t handle, adc_raw_t *data)
   return err;
 }
 
+// the latest reading lives in shared memory behind a seqlock; whoever
+// finds it older than the period reads the bus for everybody, the lock
+// file keeps that to one process at a time
+#define ADC_SHM_NAME       "/mug_adc_sample"
+#define LOCK_ADC_BUS       "/tmp/smart_mug_adc_bus"
+#define ADC_PERIOD_DEFAULT 100 // ms
+
+typedef struct _adc_shared_t {
+  volatile uint32_t seq;     // odd while being written
+  adc_raw_t         raw;
+  long long         stamp;   // us, CLOCK_MONOTONIC
+} adc_shared_t;
+
+static adc_shared_t   *adc_shared = NULL;
+static adc_shared_t    adc_local;
+static int             adc_lock = -1;
+static int             adc_period = ADC_PERIOD_DEFAULT;
+static pthread_mutex_t adc_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// false if a writer holds it for too long, it may have died mid-write
+static bool load_adc_shared(const adc_shared_t *sh, adc_raw_t *raw, long long *stamp)
+{
+  uint32_t seq;
+  int spins = 0;
+
+  do {
+    while((seq = sh->seq) & 1) {
+      if(++spins > 1000)
+        return false;
+    }
+    __sync_synchronize();
+    memcpy(raw, (const void*)sh->raw, sizeof(adc_raw_t));
+    *stamp = sh->stamp;
+    __sync_synchronize();
+  } while(sh->seq != seq);
+
+  return true;
+}
+
+static void store_adc_shared(adc_shared_t *sh, const adc_raw_t *raw, long long stamp)
+{
+  sh->seq++;
+  __sync_synchronize();
+  memcpy((void*)sh->raw, raw, sizeof(adc_raw_t));
+  sh->stamp = stamp;
+  __sync_synchronize();
+  sh->seq++;
+}
+
+mug_error_t read_adc_sample(handle_t handle, adc_raw_t *raw, long long *stamp)
+{
+  mug_error_t err = ERROR_NONE;
+
+  pthread_mutex_lock(&adc_mutex);
+
+  if(adc_shared == NULL) {
+    adc_shared = (adc_shared_t*)map_shared(ADC_SHM_NAME, sizeof(adc_shared_t));
+    if(adc_shared != NULL) {
+      adc_lock = open(LOCK_ADC_BUS, O_RDWR | O_CREAT, 0666);
+      if(adc_lock == -1)
+        munmap(adc_shared, sizeof(adc_shared_t));
+    }
+
+    // on our own the mutex is enough
+    if(adc_lock == -1)
+      adc_shared = &adc_local;
+  }
+
+  long long max_age = adc_period * 1000LL;
+
+  if(!load_adc_shared(adc_shared, raw, stamp) || *stamp == 0 || now_us() - *stamp >= max_age) {
+    if(adc_lock != -1)
+      lockf(adc_lock, F_LOCK, 0);
+
+    // writers hold the lock, so an odd count here was left by a dead one
+    if(adc_shared->seq & 1)
+      adc_shared->seq++;
+
+    // somebody may have refreshed it while we waited for the lock
+    load_adc_shared(adc_shared, raw, stamp);
+
+    if(*stamp == 0 || now_us() - *stamp >= max_age) {
+      err = mug_read_adc(handle, raw);
+      if(err == ERROR_NONE) {
+        *stamp = now_us();
+        store_adc_shared(adc_shared, raw, *stamp);
+      }
+    }
+
+    if(adc_lock != -1)
+      lockf(adc_lock, F_ULOCK, 0);
+  }
+
+  pthread_mutex_unlock(&adc_mutex);
+
+  return err;
+}
+
+mug_error_t mug_adc_sample(handle_t handle, adc_sample_t *sample)
+{
+  adc_raw_t raw;
+  mug_error_t err = read_adc_sample(handle, &raw, &(sample->stamp));
+
+  if(err != ERROR_NONE)
+    return err;
+
+  sample->mug_temp   = raw[MUG_TEMP_IDX] & 0x3ff;
+  sample->board_temp = raw[BOARD_TEMP_IDX] & 0x3ff;
+  sample->battery    = raw[BATTERY_IDX] & 0x3ff;
+  sample->charging   = (raw[BATTERY_IDX] & 0x8000) != 0;
+
+  return err;
+}
+
+void mug_config_adc_period(handle_t handle, int period)
+{
+  adc_period = period;
+}
+
 int mug_read_board_temp(handle_t handle)
 {
   adc_raw_t raw;
-  mug_read_adc(handle, &raw);
+  long long stamp;
+  if(read_adc_sample(handle, &raw, &stamp) != ERROR_NONE)
+    return MUG_ADC_ERROR;
   return voltage_to_temp(raw[BOARD_TEMP_IDX]);
 }
 
 int mug_read_mug_temp(handle_t handle)
 {
   adc_raw_t raw;
-  mug_read_adc(handle, &raw);
+  long long stamp;
+  if(read_adc_sample(handle, &raw, &stamp) != ERROR_NONE)
+    return MUG_ADC_ERROR;
   return voltage_to_temp(raw[MUG_TEMP_IDX]);
 }
 
 int mug_read_battery(handle_t handle, bool *is_charge)
 {
   adc_raw_t raw;
-  mug_read_adc(handle, &raw);
+  long long stamp;
+  if(read_adc_sample(handle, &raw, &stamp) != ERROR_NONE)
+    return MUG_ADC_ERROR;
   
   return voltage_to_percent(raw[BATTERY_IDX], is_charge);
 }
 
-void run_adc_timer(uv_timer_t *req, int status)
+static int16_t window_median(adc_channel_t *ch, int n)
+{
+  int16_t w[ADC_OVERSAMPLE_MAX];
+
+  memcpy(w, ch->window, n * sizeof(int16_t));
+  nth_element(w, w + n / 2, w + n);
+
+  return w[n / 2];
+}
+
+#define ADC_TEMP_CHANGED    1
+#define ADC_BATTERY_CHANGED 2
+
+// collect one sample; when the window is full, the ADC_*_CHANGED bits of
+// the callbacks whose filtered values moved past their deadband
+int filter_adc(req_temp_t *rt, const adc_raw_t *raw, long long stamp)
+{
+  // a tick that lands just inside the adc period gets the shared reading again
+  if(stamp == rt->stamp)
+    return 0;
+
+  rt->stamp = stamp;
+
+  for(int i = 0; i < TEMP_NUM; i++)
+    rt->channel[i].window[rt->count] = (*raw)[i] & 0x3ff;
+
+  if((*raw)[BATTERY_IDX] & 0x8000)
+    rt->charging++;
+
+  if(++rt->count < rt->filter.samples)
+    return 0;
+
+  for(int i = 0; i < TEMP_NUM; i++) {
+    adc_channel_t *ch = &rt->channel[i];
+    int16_t median = window_median(ch, rt->count);
+
+    if(rt->primed)
+      ch->value += (median - ch->value) / (1 << ADC_IIR_SHIFT);
+    else
+      ch->value = median;
+  }
+
+  bool charging = rt->charging * 2 > rt->count;
+
+  rt->primed   = true;
+  rt->count    = 0;
+  rt->charging = 0;
+
+  int mug_temp   = voltage_to_temp((int)lroundf(rt->channel[MUG_TEMP_IDX].value));
+  int board_temp = voltage_to_temp((int)lroundf(rt->channel[BOARD_TEMP_IDX].value));
+
+  bool is_charging;
+  int percent = voltage_to_percent((int)lroundf(rt->channel[BATTERY_IDX].value) | (charging ? 0x8000 : 0),
+                                   &is_charging);
+
+  int changed = 0;
+
+  if(rt->temp_cb != NULL
+     && (!rt->temp_reported
+         || abs(mug_temp - rt->mug_temp) > rt->filter.temp_deadband
+         || abs(board_temp - rt->board_temp) > rt->filter.temp_deadband)) {
+    rt->temp_reported = true;
+    rt->mug_temp      = mug_temp;
+    rt->board_temp    = board_temp;
+    changed |= ADC_TEMP_CHANGED;
+  }
+
+  if(rt->battery_cb != NULL
+     && (!rt->battery_reported
+         || abs(percent - rt->percent) > rt->filter.battery_deadband
+         || (int)is_charging != rt->is_charging)) {
+    rt->battery_reported = true;
+    rt->percent          = percent;
+    rt->is_charging      = is_charging;
+    changed |= ADC_BATTERY_CHANGED;
+  }
+
+  return changed;
+}
+
+void notify_adc(req_temp_t *rt, const adc_raw_t *raw, long long stamp)
 {
-  req_temp_t *rt = (req_temp_t*)(req->data);
-  adc_raw_t raw;
-  mug_read_adc(rt->handle, &raw);
   bool is_charging = true;
   int percent = 0;
 
+  if(rt->filter.samples > 0) {
+    int changed = filter_adc(rt, raw, stamp);
+
+    if(changed & ADC_TEMP_CHANGED)
+      rt->temp_cb(rt->mug_temp, rt->board_temp);
+
+    if(changed & ADC_BATTERY_CHANGED)
+      rt->battery_cb(rt->percent, rt->is_charging);
+
+    return;
+  }
+
   if(rt->temp_cb != NULL) {
-    rt->temp_cb(voltage_to_temp(raw[MUG_TEMP_IDX]), voltage_to_temp(raw[BOARD_TEMP_IDX]));
+    rt->temp_cb(voltage_to_temp((*raw)[MUG_TEMP_IDX]), voltage_to_temp((*raw)[BOARD_TEMP_IDX]));
   }
 
   if(rt->battery_cb != NULL) {
-    percent = voltage_to_percent(raw[BATTERY_IDX], &is_charging);
+    percent = voltage_to_percent((*raw)[BATTERY_IDX], &is_charging);
     rt->battery_cb(percent, (int)is_charging); 
   }
 }
 
+void run_adc_timer(uv_timer_t *req, int status)
+{
+  adc_raw_t raw;
+  long long stamp;
+  bool sampled = false;
+  mug_error_t err = ERROR_NONE;
+
+  // half a tick of slack so timer jitter does not push a watcher a whole tick late
+  uint64_t now = uv_now(temp_loop) + adc_tick / 2;
+
+  for(adc_watchers_t::iterator itr = adc_watchers.begin();
+      itr != adc_watchers.end();
+      itr++) {
+    req_temp_t *rt = *itr;
+
+    if(rt->due > now)
+      continue;
+
+    if(!sampled) {
+      err = read_adc_sample(rt->handle, &raw, &stamp);
+      sampled = true;
+    }
+
+    // nothing is reported from a failed read, the due watchers retry next tick
+    if(err != ERROR_NONE)
+      return;
+
+    rt->due += rt->interval;
+    if(rt->due <= now)
+      rt->due = now + rt->interval;
+
+    notify_adc(rt, &raw, stamp);
+  }
+}
+
+static int gcd(int a, int b)
+{
+  while(b != 0) {
+    int t = a % b;
+    a = b;
+    b = t;
+  }
+
+  return a;
+}
+
+void mug_config_adc_filter(handle_t handle, int samples, int temp_deadband, int battery_deadband)
+{
+  MUG_ASSERT(samples >= 0 && samples <= ADC_OVERSAMPLE_MAX,
+             "adc oversampling must be 0 to %d\n", ADC_OVERSAMPLE_MAX);
+
+  adc_filter.samples          = samples;
+  adc_filter.temp_deadband    = temp_deadband;
+  adc_filter.battery_deadband = battery_deadband;
+}
+
 #ifdef USE_LIBUV
 
 int mug_adc_on(handle_t handle, temp_cb_t temp_cb, battery_cb_t battery_cb, int interval)
 {
-  if(temp_loop == NULL) 
+  MUG_ASSERT(interval > 0, "adc watcher interval must be positive\n");
+
+  if(temp_loop == NULL) {
     temp_loop = uv_default_loop();
+    uv_timer_init(temp_loop, &temp_timer);
+  }
 
   req_temp_t *req = (req_temp_t*)malloc(sizeof(req_temp_t));
 
@@ -282,11 +831,23 @@ int mug_adc_on(handle_t handle, temp_cb_t temp_cb, battery_cb_t battery_cb, int
   if(battery_cb != NULL) {
     req->battery_cb = battery_cb;
   }
-  
-  temp_timer.data = (void*)req;
 
-  uv_timer_init(temp_loop, &temp_timer);
-  uv_timer_start(&temp_timer, run_adc_timer, 0, interval);
+  // the samples are spread over the period, but no closer than the shared
+  // reading is refreshed or the window would hold copies of one reading
+  req->filter = adc_filter;
+  if(req->filter.samples > 1)
+    interval = max(interval / req->filter.samples, adc_period);
+
+  req->interval = interval;
+  req->due      = uv_now(temp_loop);
+
+  adc_watchers.push_back(req);
+
+  // the first tick comes right away and takes the new watcher's first sample
+  adc_tick = gcd(adc_tick, interval);
+  uv_timer_start(&temp_timer, run_adc_timer, 0, adc_tick);
+
+  return 0;
 }
 
 int mug_temp_on(handle_t handle, temp_cb_t cb, int interval)
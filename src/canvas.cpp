@@ -0,0 +1,127 @@
+#include <stdlib.h>
+#include <string.h>
+#include <mug.h>
+#include <pack.h>
+
+#define CLIP(v, lo, hi) ((v) < (lo) ? (lo) : ((v) > (hi) ? (hi) : (v)))
+
+void mug_canvas_fill(mug_canvas_t *canvas, unsigned char color)
+{
+  color &= 0xf;
+  memset(canvas->raw, color | (color << 4), COMPRESSED_SIZE);
+}
+
+void mug_canvas_pixel(mug_canvas_t *canvas, int col, int row, unsigned char color)
+{
+  if(col < 0 || col >= MAX_COLS || row < 0 || row >= MAX_ROWS)
+    return;
+
+  raw_put_bits(canvas->raw, col, row, color & 0xf, 0xf);
+}
+
+void mug_canvas_rect(mug_canvas_t *canvas, int col, int row, int width, int height, unsigned char color, int filled)
+{
+  int start = CLIP(col, 0, MAX_COLS);
+  int end = CLIP(col + width, 0, MAX_COLS);
+
+  if(start >= end || height <= 0)
+    return;
+
+  // color repeated in every nibble, masks select the visible columns
+  uint64_t bits = (color & 0xf) * 0x1111111111111111ULL;
+  uint64_t line = raw_width_mask(end - start) << (4 * start);
+  uint64_t edge = 0;
+
+  if(col >= 0)
+    edge |= 0xfULL << (4 * col);
+
+  if(col + width <= MAX_COLS)
+    edge |= 0xfULL << (4 * (col + width - 1));
+
+  for(int r = 0; r < height && row + r < MAX_ROWS; r++) {
+    if(filled || r == 0 || r == height - 1)
+      raw_put_bits(canvas->raw, 0, row + r, bits, line);
+    else
+      raw_put_bits(canvas->raw, 0, row + r, bits, edge);
+  }
+}
+
+void mug_canvas_line(mug_canvas_t *canvas, int col0, int row0, int col1, int row1, unsigned char color)
+{
+  int dx = abs(col1 - col0), sx = col0 < col1 ? 1 : -1;
+  int dy = -abs(row1 - row0), sy = row0 < row1 ? 1 : -1;
+  int err = dx + dy, e2;
+
+  // bresenham
+  while(true) {
+    mug_canvas_pixel(canvas, col0, row0, color);
+
+    if(col0 == col1 && row0 == row1)
+      break;
+
+    e2 = 2 * err;
+    if(e2 >= dy) {
+      err += dy;
+      col0 += sx;
+    }
+    if(e2 <= dx) {
+      err += dx;
+      row0 += sy;
+    }
+  }
+}
+
+void mug_canvas_blit(mug_canvas_t *canvas, int col, int row,
+                     const mug_canvas_t *src, int src_col, int src_row, int width, int height)
+{
+  // clip the source region to the source canvas
+  if(src_col < 0) {
+    col -= src_col;
+    width += src_col;
+    src_col = 0;
+  }
+
+  if(src_row < 0) {
+    row -= src_row;
+    height += src_row;
+    src_row = 0;
+  }
+
+  width = CLIP(width, 0, MAX_COLS - src_col);
+  height = CLIP(height, 0, MAX_ROWS - src_row);
+
+  // also keeps src_col below MAX_COLS for the shift
+  if(width <= 0 || height <= 0)
+    return;
+
+  uint64_t mask = raw_width_mask(width);
+
+  for(int r = 0; r < height; r++) {
+    uint64_t line = raw_get_row(src->raw, src_row + r) >> (4 * src_col);
+    raw_put_bits(canvas->raw, col, row + r, line, mask);
+  }
+}
+
+void mug_canvas_sprite(mug_canvas_t *canvas, int col, int row, const mug_sprite_t *sprite)
+{
+  raw_draw_sprite(canvas->raw, col, row, sprite);
+}
+
+void mug_canvas_number(mug_canvas_t *canvas, int col, int row, const char *str, unsigned char color)
+{
+  unsigned char rgb[3];
+  raw_2_rgb(color, rgb);
+  draw_number_raw(canvas->raw, col, row, str, rgb);
+}
+
+int mug_canvas_text(mug_canvas_t *canvas, int col, int row, const char *text, unsigned char color)
+{
+  unsigned char rgb[3];
+  raw_2_rgb(color, rgb);
+  return draw_text_raw(canvas->raw, col, row, text, rgb, SCREEN_HEIGHT);
+}
+
+mug_error_t mug_canvas_present(handle_t handle, mug_canvas_t *canvas)
+{
+  return mug_disp_raw(handle, canvas->raw);
+}
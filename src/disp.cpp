@@ -7,6 +7,7 @@
 #include <iohub_client.h>
 #include <mug.h>
 #include <res_manager.h>
+#include <frame_sched.h>
 
 #ifndef USE_IOHUB
 #include <io.h>
@@ -14,6 +15,9 @@
 
 #define MUG_SHM_KEY 0xbeef
 
+// packed pixels only use the low 3 bits of each nibble, so no frame has this
+#define FB_INVALID_BYTE 0xff
+
 static char *shm_buf = NULL;
 
 struct __attribute__((packed)) led_line_data {
@@ -22,6 +26,15 @@ struct __attribute__((packed)) led_line_data {
   uint8_t content[MAX_COLS/2];
 };
 
+struct __attribute__((packed)) led_batch_data {
+  uint8_t row_mask[2];
+  uint8_t reserved;
+  uint8_t content[FB_BATCH_ROWS][MAX_COMPRESSED_COLS];
+};
+
+static bool fb_batch = false;
+static disp_transport_t disp_transport = NULL;
+
 
 int create_shm_buf()
 {
@@ -53,56 +66,161 @@ char* get_shm_buf()
   return buf;
 }
 
-mug_error_t mug_disp_raw(handle_t handle, char* imgData) 
+// number of rows sent to mcu by the last mug_disp_raw call
+static int last_rows_sent = 0;
+
+static mug_error_t send_fb(handle_t handle, int cmd, char *data, int len)
+{
+  if(disp_transport)
+    return disp_transport(handle, cmd, data, len);
+
+#ifdef USE_IOHUB
+  return iohub_send_command(handle, (cmd_t)cmd, data, len);
+#else
+  // FB_BATCH_CMD is not a cmd_t, it goes straight to the i2c block write
+  if(cmd == FB_BATCH_CMD)
+    return (mug_error_t)iohubd_write_block_data((int)handle, cmd, len, (const __u8*)data);
+
+  return dev_send_command(handle, (cmd_t)cmd, data, len);
+#endif
+}
+
+static mug_error_t send_rows(handle_t handle, char *imgData, int *rows, int num)
 {
-  int row, col;
-  char *p = imgData;
   mug_error_t err = MUG_ERROR_NONE;
 
   struct led_line_data data = {
     0, {0xff, 0xff}, {0}
   };
 
-  if(memcmp(shm_buf, imgData, COMPRESSED_SIZE) == 0) {
-    return ERROR_NONE;
-  } else {
-    memcpy(shm_buf, imgData, COMPRESSED_SIZE);
+  for(int i = 0; i < num; i++) {
+    data.row = rows[i];
+    memcpy(&(data.content), imgData + rows[i] * MAX_COMPRESSED_COLS, MAX_COMPRESSED_COLS);
+
+    err = send_fb(handle, IOHUB_CMD_FB, (char*)&data, sizeof(data));
+    if(err != ERROR_NONE)
+      return err;
   }
 
-  for(row = 0; row < MAX_COMPRESSED_ROWS; row++) {
+  return err;
+}
 
-    // pack the data
-    data.row = row;
-    memcpy(&(data.content), p, MAX_COMPRESSED_COLS);
+static mug_error_t send_rows_batch(handle_t handle, char *imgData, int *rows, int num)
+{
+  mug_error_t err = MUG_ERROR_NONE;
+  struct led_batch_data data;
+  uint16_t mask;
+  int n;
 
-    // send to iohub
-#ifdef USE_IOHUB
-    err = iohub_send_command(handle, IOHUB_CMD_FB, (char*)&data, sizeof(data));
-#else
-    err = dev_send_command(handle, IOHUB_CMD_FB, (char*)&data, sizeof(data));
-#endif
- 
-    if(err != ERROR_NONE) {
-      MUG_ASSERT(0, "iohub_send_command error: %d\n", err);
-      return err; 
+  for(int i = 0; i < num; i += n) {
+    mask = 0;
+    for(n = 0; n < FB_BATCH_ROWS && i + n < num; n++) {
+      mask |= 1 << rows[i + n];
+      memcpy(data.content[n], imgData + rows[i + n] * MAX_COMPRESSED_COLS, MAX_COMPRESSED_COLS);
     }
 
-    // go to the next row
-    p += MAX_COMPRESSED_COLS;  
+    data.row_mask[0] = mask & 0xff;
+    data.row_mask[1] = mask >> 8;
+    data.reserved = 0xff;
+
+    err = send_fb(handle, FB_BATCH_CMD, (char*)&data, FB_BATCH_HEADER + n * MAX_COMPRESSED_COLS);
+    if(err != ERROR_NONE)
+      return err;
   }
 
   return err;
 }
 
+mug_error_t mug_disp_raw(handle_t handle, char* imgData) 
+{
+  int rows[MAX_COMPRESSED_ROWS];
+  int num = 0;
+  int offset;
+  mug_error_t err;
+
+  if(shm_buf == NULL)
+    shm_buf = get_shm_buf();
+
+  // only rows different from the shared frame buffer are sent
+  for(int row = 0; row < MAX_COMPRESSED_ROWS; row++) {
+    offset = row * MAX_COMPRESSED_COLS;
+    if(memcmp(shm_buf + offset, imgData + offset, MAX_COMPRESSED_COLS) != 0)
+      rows[num++] = row;
+  }
+
+  last_rows_sent = num;
+
+  if(num == 0)
+    return ERROR_NONE;
+
+  if(fb_batch)
+    err = send_rows_batch(handle, imgData, rows, num);
+  else
+    err = send_rows(handle, imgData, rows, num);
+
+  if(err != ERROR_NONE) {
+    MUG_ASSERT(0, "iohub_send_command error: %d\n", err);
+    return err; 
+  }
+
+  for(int i = 0; i < num; i++) {
+    offset = rows[i] * MAX_COMPRESSED_COLS;
+    memcpy(shm_buf + offset, imgData + offset, MAX_COMPRESSED_COLS);
+  }
+
+  return err;
+}
+
+int mug_disp_rows_sent(handle_t handle)
+{
+  return last_rows_sent;
+}
+
+// iohubd only routes cmd_t commands, so there batching needs a transport
+int mug_disp_set_batch(handle_t handle, int enable)
+{
+#ifdef USE_IOHUB
+  if(enable && disp_transport == NULL)
+    return -1;
+#endif
+
+  fb_batch = enable;
+  return 0;
+}
+
+// force the next frame to be sent completely, by whichever process draws it
+void mug_disp_invalidate(handle_t handle)
+{
+  if(shm_buf == NULL)
+    shm_buf = get_shm_buf();
+
+  memset(shm_buf, FB_INVALID_BYTE, COMPRESSED_SIZE);
+}
+
+void mug_disp_set_transport(disp_transport_t transport)
+{
+  disp_transport = transport;
+
+#ifdef USE_IOHUB
+  if(transport == NULL)
+    fb_batch = false;
+#endif
+}
+
 char lastImg[COMPRESSED_SIZE];
 mug_error_t mug_disp_raw_N(handle_t handle, char* imgData, int number, int interval)
 {
   int semResource = resource_init(LOCK_DISPLAY_TOUCH);
   char *p = imgData;
   mug_error_t error = ERROR_NONE;
+  frame_sched_t sched;
   int i;
   resource_wait(semResource);
-  for(i = 0; i < number; i++) {
+  sched_init(&sched, interval);
+  for(i = 0; i < number; i++, p += COMPRESSED_SIZE) {
+
+    if(!sched_next(&sched))
+      continue;
     
     error = mug_disp_raw(handle, p);
 
@@ -112,9 +230,11 @@ mug_error_t mug_disp_raw_N(handle_t handle, char* imgData, int number, int inter
       resource_post(semResource);
       return error;
     }
-    p += COMPRESSED_SIZE;
-    usleep(interval * 1000);
   }
+
+  // frames paced by caller (interval 0) do not count as an animation
+  if(interval > 0)
+    sched_finish(&sched);
   resource_post(semResource);
 
   return error;
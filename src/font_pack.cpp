@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <mug.h>
+#include <font_pack.h>
+
+static const unsigned char      *pack = NULL;
+static size_t                    pack_size = 0;
+static const font_pack_header_t *header = NULL;
+static const font_pack_glyph_t  *glyphs = NULL;
+
+static bool validate_pack()
+{
+  if(pack_size < sizeof(font_pack_header_t))
+    return false;
+
+  header = (const font_pack_header_t*)pack;
+
+  if(header->magic != FONT_PACK_MAGIC || header->version != FONT_PACK_VERSION)
+    return false;
+
+  // divided rather than multiplied so a huge count can not wrap on 32 bit
+  if(header->count > (pack_size - sizeof(font_pack_header_t)) / sizeof(font_pack_glyph_t))
+    return false;
+
+  glyphs = (const font_pack_glyph_t*)(pack + sizeof(font_pack_header_t));
+
+  for(uint32_t i = 0; i < header->count; i++) {
+    const font_pack_glyph_t *g = &glyphs[i];
+
+    if(i > 0 && glyphs[i - 1].code >= g->code)
+      return false;
+
+    if(g->offset > pack_size || FONT_PACK_PITCH(g->width) * g->rows > pack_size - g->offset)
+      return false;
+  }
+
+  return true;
+}
+
+// map a font pack, returns 0 on success
+int font_pack_open(const char *path)
+{
+  struct stat st;
+
+  font_pack_close();
+
+  int fd = open(path, O_RDONLY);
+  if(fd < 0) {
+    printf("can not open font pack: %s\n", path);
+    return -1;
+  }
+
+  if(fstat(fd, &st) < 0 || st.st_size == 0) {
+    close(fd);
+    return -1;
+  }
+
+  void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if(addr == MAP_FAILED)
+    return -1;
+
+  pack = (const unsigned char*)addr;
+  pack_size = st.st_size;
+
+  if(!validate_pack()) {
+    printf("invalid font pack: %s\n", path);
+    font_pack_close();
+    return -1;
+  }
+
+  return 0;
+}
+
+void font_pack_close()
+{
+  if(pack != NULL)
+    munmap((void*)pack, pack_size);
+
+  pack = NULL;
+  pack_size = 0;
+  header = NULL;
+  glyphs = NULL;
+}
+
+// 0 if no font pack is loaded
+int font_pack_height()
+{
+  return header ? header->height : 0;
+}
+
+const font_pack_glyph_t* font_pack_find(uint32_t code)
+{
+  if(header == NULL)
+    return NULL;
+
+  int low = 0, high = (int)header->count - 1, mid;
+
+  while(low <= high) {
+    mid = (low + high) / 2;
+
+    if(glyphs[mid].code == code)
+      return &glyphs[mid];
+
+    if(glyphs[mid].code < code)
+      low = mid + 1;
+    else
+      high = mid - 1;
+  }
+
+  return NULL;
+}
+
+const unsigned char* font_pack_bitmap(const font_pack_glyph_t *glyph)
+{
+  return pack + glyph->offset;
+}
@@ -0,0 +1,95 @@
+#include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include <frame_sched.h>
+#include <mono_time.h>
+
+#define NSEC_PER_SEC  1000000000LL
+#define NSEC_PER_USEC 1000LL
+#define NSEC_PER_MSEC 1000000LL
+
+static disp_stat_t last_stat;
+static pthread_mutex_t stat_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static long long ts_to_ns(const struct timespec *ts)
+{
+  return ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static void ns_to_ts(long long ns, struct timespec *ts)
+{
+  ts->tv_sec = ns / NSEC_PER_SEC;
+  ts->tv_nsec = ns % NSEC_PER_SEC;
+}
+
+static void sleep_until(long long deadline)
+{
+  struct timespec ts;
+  ns_to_ts(deadline, &ts);
+
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+void sched_init(frame_sched_t *s, int interval)
+{
+  sched_init_ns(s, interval * NSEC_PER_MSEC);
+}
+
+// for rates whose period is not a whole number of ms
+void sched_init_ns(frame_sched_t *s, long long interval)
+{
+  memset(s, 0, sizeof(frame_sched_t));
+  clock_gettime(CLOCK_MONOTONIC, &(s->start));
+  s->interval = interval;
+}
+
+// wait for the deadline of the next frame, returns false if the frame
+// has already missed its whole slot and should be dropped
+bool sched_next(frame_sched_t *s)
+{
+  long long deadline = ts_to_ns(&(s->start)) + s->frame * s->interval;
+  long long now = now_ns();
+
+  s->frame++;
+
+  if(s->interval > 0 && now >= deadline + s->interval) {
+    s->stat.dropped++;
+    return false;
+  }
+
+  if(now < deadline) {
+    sleep_until(deadline);
+    now = now_ns();
+  }
+
+  int jitter = (now - deadline) / NSEC_PER_USEC;
+
+  s->jitter_sum += jitter;
+  if(jitter > s->stat.max_jitter)
+    s->stat.max_jitter = jitter;
+
+  s->stat.frames++;
+
+  return true;
+}
+
+// publish the statistics, optionally holding the last frame for its slot
+void sched_finish(frame_sched_t *s, bool hold)
+{
+  if(hold)
+    sleep_until(ts_to_ns(&(s->start)) + s->frame * s->interval);
+
+  if(s->stat.frames > 0)
+    s->stat.avg_jitter = s->jitter_sum / s->stat.frames;
+
+  pthread_mutex_lock(&stat_mutex);
+  last_stat = s->stat;
+  pthread_mutex_unlock(&stat_mutex);
+}
+
+void mug_disp_get_stat(handle_t handle, disp_stat_t *stat)
+{
+  pthread_mutex_lock(&stat_mutex);
+  *stat = last_stat;
+  pthread_mutex_unlock(&stat_mutex);
+}
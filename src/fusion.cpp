@@ -0,0 +1,199 @@
+#include <string.h>
+#include <math.h>
+#include <mug.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// MPU6050 at its default +-250 deg/s range, 131 LSB per deg/s
+#define GYRO_SCALE  (3.14159265f / 180.0f / 131.0f)
+
+#define DEFAULT_KP  2.0f
+#define DEFAULT_KI  0.005f
+
+#define RAD2DEG     (180.0f / 3.14159265f)
+
+// samples are converted a chunk at a time into planar floats
+#define FUSION_CHUNK 64
+
+typedef struct _fusion_chunk_t {
+  float ax[FUSION_CHUNK] __attribute__((aligned(16)));
+  float ay[FUSION_CHUNK] __attribute__((aligned(16)));
+  float az[FUSION_CHUNK] __attribute__((aligned(16)));
+  float gx[FUSION_CHUNK] __attribute__((aligned(16)));
+  float gy[FUSION_CHUNK] __attribute__((aligned(16)));
+  float gz[FUSION_CHUNK] __attribute__((aligned(16)));
+} fusion_chunk_t;
+
+void mug_fusion_init(mug_fusion_t *f)
+{
+  memset(f, 0, sizeof(mug_fusion_t));
+
+  f->q[0] = 1.0f;
+  f->kp = DEFAULT_KP;
+  f->ki = DEFAULT_KI;
+  f->gyro_scale = GYRO_SCALE;
+
+  // bias of the mug's sensor
+  f->gyro_offset[0] = -200;
+  f->gyro_offset[1] = 100;
+  f->gyro_offset[2] = 80;
+}
+
+// unit accel vector (0 if there is none) and gyro in rad/s
+static void prepare_c(const mug_fusion_t *f, const motion_data_t *s, int from, int n, fusion_chunk_t *c)
+{
+  for(int i = from; i < n; i++) {
+    float ax = s[i].ax, ay = s[i].ay, az = s[i].az;
+    float r = ax * ax + ay * ay + az * az;
+    float inv = r > 0.0f ? 1.0f / sqrtf(r) : 0.0f;
+
+    c->ax[i] = ax * inv;
+    c->ay[i] = ay * inv;
+    c->az[i] = az * inv;
+    c->gx[i] = (s[i].gx - f->gyro_offset[0]) * f->gyro_scale;
+    c->gy[i] = (s[i].gy - f->gyro_offset[1]) * f->gyro_scale;
+    c->gz[i] = (s[i].gz - f->gyro_offset[2]) * f->gyro_scale;
+  }
+}
+
+#ifdef __SSE2__
+#define LANES(s, f) _mm_set_ps((s)[3].f, (s)[2].f, (s)[1].f, (s)[0].f)
+
+// four samples per step, rsqrt with one Newton step for the accel norm
+static void prepare_sse2(const mug_fusion_t *f, const motion_data_t *s, int n, fusion_chunk_t *c)
+{
+  const __m128 half  = _mm_set1_ps(0.5f);
+  const __m128 three = _mm_set1_ps(3.0f);
+  const __m128 zero  = _mm_setzero_ps();
+  const __m128 scale = _mm_set1_ps(f->gyro_scale);
+  const __m128 ox = _mm_set1_ps(f->gyro_offset[0]);
+  const __m128 oy = _mm_set1_ps(f->gyro_offset[1]);
+  const __m128 oz = _mm_set1_ps(f->gyro_offset[2]);
+  int i;
+
+  for(i = 0; i + 4 <= n; i += 4) {
+    __m128 ax = LANES(s + i, ax);
+    __m128 ay = LANES(s + i, ay);
+    __m128 az = LANES(s + i, az);
+
+    __m128 r = _mm_add_ps(_mm_mul_ps(ax, ax), _mm_add_ps(_mm_mul_ps(ay, ay), _mm_mul_ps(az, az)));
+    __m128 inv = _mm_rsqrt_ps(r);
+    inv = _mm_mul_ps(_mm_mul_ps(half, inv), _mm_sub_ps(three, _mm_mul_ps(r, _mm_mul_ps(inv, inv))));
+    inv = _mm_and_ps(inv, _mm_cmpgt_ps(r, zero));
+
+    _mm_store_ps(c->ax + i, _mm_mul_ps(ax, inv));
+    _mm_store_ps(c->ay + i, _mm_mul_ps(ay, inv));
+    _mm_store_ps(c->az + i, _mm_mul_ps(az, inv));
+    _mm_store_ps(c->gx + i, _mm_mul_ps(_mm_sub_ps(LANES(s + i, gx), ox), scale));
+    _mm_store_ps(c->gy + i, _mm_mul_ps(_mm_sub_ps(LANES(s + i, gy), oy), scale));
+    _mm_store_ps(c->gz + i, _mm_mul_ps(_mm_sub_ps(LANES(s + i, gz), oz), scale));
+  }
+
+  prepare_c(f, s, i, n, c);
+}
+
+// q += q * (0, g) * dt / 2, then normalize, one register for q
+static void integrate(float *q, float gx, float gy, float gz, float hdt)
+{
+  __m128 v = _mm_loadu_ps(q);
+
+  __m128 d = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(gx * hdt), _mm_set_ps(-1, 1, 1, -1)),
+                        _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+  d = _mm_add_ps(d, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(gy * hdt), _mm_set_ps(1, 1, -1, -1)),
+                               _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2))));
+  d = _mm_add_ps(d, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(gz * hdt), _mm_set_ps(1, -1, 1, -1)),
+                               _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3))));
+  v = _mm_add_ps(v, d);
+
+  __m128 sq = _mm_mul_ps(v, v);
+  sq = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+  sq = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(1, 0, 3, 2)));
+
+  _mm_storeu_ps(q, _mm_div_ps(v, _mm_sqrt_ps(sq)));
+}
+#else
+static void integrate(float *q, float gx, float gy, float gz, float hdt)
+{
+  float w0 = q[0], x0 = q[1], y0 = q[2], z0 = q[3];
+
+  float w = w0 + (-x0 * gx - y0 * gy - z0 * gz) * hdt;
+  float x = x0 + ( w0 * gx + y0 * gz - z0 * gy) * hdt;
+  float y = y0 + ( w0 * gy - x0 * gz + z0 * gx) * hdt;
+  float z = z0 + ( w0 * gz + x0 * gy - y0 * gx) * hdt;
+
+  float inv = 1.0f / sqrtf(w * w + x * x + y * y + z * z);
+
+  q[0] = w * inv;
+  q[1] = x * inv;
+  q[2] = y * inv;
+  q[3] = z * inv;
+}
+#endif
+
+// pull the gyro towards the gravity the accel sees, then integrate
+static void fusion_step(mug_fusion_t *f, float ax, float ay, float az,
+                        float gx, float gy, float gz, float dt)
+{
+  float *q = f->q;
+
+  if(ax != 0.0f || ay != 0.0f || az != 0.0f) {
+    // gravity in the sensor frame as estimated by q
+    float vx = 2.0f * (q[1] * q[3] - q[0] * q[2]);
+    float vy = 2.0f * (q[0] * q[1] + q[2] * q[3]);
+    float vz = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+
+    float ex = ay * vz - az * vy;
+    float ey = az * vx - ax * vz;
+    float ez = ax * vy - ay * vx;
+
+    f->integral[0] += f->ki * ex * dt;
+    f->integral[1] += f->ki * ey * dt;
+    f->integral[2] += f->ki * ez * dt;
+
+    gx += f->kp * ex + f->integral[0];
+    gy += f->kp * ey + f->integral[1];
+    gz += f->kp * ez + f->integral[2];
+  }
+
+  integrate(q, gx, gy, gz, 0.5f * dt);
+}
+
+void mug_fusion_attitude(const mug_fusion_t *f, mug_attitude_t *out)
+{
+  float w = f->q[0], x = f->q[1], y = f->q[2], z = f->q[3];
+  float sp = 2.0f * (w * y - z * x);
+
+  if(sp > 1.0f)
+    sp = 1.0f;
+  if(sp < -1.0f)
+    sp = -1.0f;
+
+  memcpy(out->q, f->q, sizeof(out->q));
+  out->roll  = atan2f(2.0f * (w * x + y * z), 1.0f - 2.0f * (x * x + y * y)) * RAD2DEG;
+  out->pitch = asinf(sp) * RAD2DEG;
+  out->yaw   = atan2f(2.0f * (w * z + x * y), 1.0f - 2.0f * (y * y + z * z)) * RAD2DEG;
+}
+
+void mug_fusion_update(mug_fusion_t *f, const motion_data_t *samples, int n, float dt, mug_attitude_t *out)
+{
+  fusion_chunk_t c;
+
+  for(int base = 0; base < n; base += FUSION_CHUNK) {
+    int len = n - base < FUSION_CHUNK ? n - base : FUSION_CHUNK;
+
+#ifdef __SSE2__
+    prepare_sse2(f, samples + base, len, &c);
+#else
+    prepare_c(f, samples + base, 0, len, &c);
+#endif
+
+    for(int i = 0; i < len; i++) {
+      fusion_step(f, c.ax[i], c.ay[i], c.az[i], c.gx[i], c.gy[i], c.gz[i], dt);
+
+      if(out != NULL)
+        mug_fusion_attitude(f, &out[base + i]);
+    }
+  }
+}
@@ -1,10 +1,14 @@
 #include <mug.h>
 #include <config.h>
 #include <utf8.h>
+#include <frame_sched.h>
+#include <pack.h>
+#include <font_pack.h>
 #include <time.h>
 
 #include <list>
 #include <vector>
+#include <map>
 #include <string>
 using namespace std;
 
@@ -74,8 +78,6 @@ unsigned char black[]  = {0,   0,   0  };
 
 char *disp_font = NULL;
 
-#define LATCH 80
-
 #define MAX_FILE_NAME 512
 
 char *get_proc_dir() {
@@ -142,6 +144,12 @@ unsigned char rgb_2_raw(unsigned char R, unsigned char G, unsigned B)
   return raw; 
 }
 
+void raw_2_rgb(unsigned char raw, unsigned char rgb[3])
+{
+  for(int c = 0; c < 3; c++)
+    rgb[c] = (raw & (1 << c)) ? 255 : 0;
+}
+
 unsigned char color_2_raw(const char *color) {
   unsigned char* data = color_to_rgb(color);
   return rgb_2_raw(data[0], data[1], data[2]);
@@ -149,8 +157,7 @@ unsigned char color_2_raw(const char *color) {
 
 int mug_cimg_to_raw(cimg_handle_t cimg, char *buf)
 {
-  cimg_t src = *(cimg_t*)cimg;
-  unsigned char *p =(unsigned char*) buf;
+  const cimg_t &src = *(cimg_t*)cimg;
   int width = src.width();
   int height = src.height();
  
@@ -159,24 +166,25 @@ int mug_cimg_to_raw(cimg_handle_t cimg, char *buf)
     return IMG_ERROR;
   }
 
-  unsigned char R, G, B, raw, offset;
-  for(int r = 0; r < height; r++) {
-    for(int c = 0; c < width; c++) {
-      R = (unsigned char)src(c, r, 0, 0);
-      G = (unsigned char)src(c, r, 0, 1);
-      B = (unsigned char)src(c, r, 0, 2);
+  // read the planar channels in place, gray images use one plane for all
+  const unsigned char *R = src.data(0, 0, 0, 0);
+  const unsigned char *G = src.spectrum() >= 3 ? src.data(0, 0, 0, 1) : R;
+  const unsigned char *B = src.spectrum() >= 3 ? src.data(0, 0, 0, 2) : R;
 
-      raw = rgb_2_raw(R, G, B);
-     
-      if( c % 2) {
-        (*p) &= 0xf; 
-        (*p) |= raw << 4;
-        p++;
-      } else {
-        (*p) &= 0xf0;
-        (*p) |= raw;
-      } 
-    }
+  pack_rgb_frame(R, G, B, width, buf);
+
+  return IMG_OK;
+}
+
+int mug_cimg_to_raw_N(cimg_handle_t *cimgs, int num, char *buf)
+{
+  int ret;
+
+  for(int i = 0; i < num; i++) {
+    ret = mug_cimg_to_raw(cimgs[i], buf);
+    if(ret != IMG_OK)
+      return ret;
+    buf += COMPRESSED_SIZE;
   }
 
   return IMG_OK;
@@ -352,18 +360,84 @@ void change_color(cimg_t &img, unsigned char *color)
   }
 }
 
+// digits recolored once per display color
+#define COLOR_NUM 8
+
+static cimg_vec_t   colored_numbers[COLOR_NUM];
+static mug_sprite_t raw_numbers[COLOR_NUM][10];
+static bool         raw_numbers_ready[COLOR_NUM];
+
+cimg_vec_t* get_colored_numbers(unsigned char *color)
+{
+  cimg_vec_t *digits = &colored_numbers[rgb_2_raw(color[0], color[1], color[2])];
+
+  if(digits->empty()) {
+    *digits = numbers;
+    for(int i = 0; i < digits->size(); i++)
+      change_color((*digits)[i], color);
+  }
+
+  return digits;
+}
+
+// black pixels are transparent unless opaque is set
+int cimg_to_sprite(const cimg_t &img, mug_sprite_t *sprite, bool opaque)
+{
+  if(img.width() > MAX_COLS || img.height() > MAX_ROWS) {
+    printf("ERROR, sprite height: %d, width %d\n", img.height(), img.width());
+    return IMG_ERROR;
+  }
+
+  sprite->width = img.width();
+  sprite->height = img.height();
+
+  for(int r = 0; r < sprite->height; r++) {
+    sprite->row[r] = 0;
+    sprite->mask[r] = 0;
+    for(int c = 0; c < sprite->width; c++) {
+      uint64_t raw = img.spectrum() >= 3
+        ? rgb_2_raw(img(c, r, 0, 0), img(c, r, 0, 1), img(c, r, 0, 2))
+        : rgb_2_raw(img(c, r), img(c, r), img(c, r));
+
+      sprite->row[r] |= raw << (4 * c);
+      if(raw || opaque)
+        sprite->mask[r] |= 0xfULL << (4 * c);
+    }
+  }
+
+  return IMG_OK;
+}
+
+mug_sprite_t* get_raw_numbers(unsigned char *color)
+{
+  unsigned char idx = rgb_2_raw(color[0], color[1], color[2]);
+  mug_sprite_t *digits = raw_numbers[idx];
+
+  if(raw_numbers_ready[idx])
+    return digits;
+
+  cimg_vec_t *colored = get_colored_numbers(color);
+
+  // digits are drawn with their black background like draw_image does
+  for(int i = 0; i < 10; i++) {
+    int err = cimg_to_sprite((*colored)[i], &digits[i], true);
+    MUG_ASSERT(err == IMG_OK, "invalid number picture %d\n", i);
+  }
+
+  raw_numbers_ready[idx] = true;
+  return digits;
+}
+
 void draw_number(cimg_t *pimg, int col, int row, const char *str, const char *c)
 {
   unsigned char *color = color_to_rgb(c);
+  cimg_vec_t *digits = get_colored_numbers(color);
 
   char *p = (char*)str;
   int next_c = col;
 
-  cimg_t img;
-
   while('0' <= *p && *p <= '9') {
-    img = numbers[*p - '0'];
-    change_color(img, color);
+    cimg_t &img = (*digits)[*p - '0'];
     pimg->draw_image(next_c, row, 0, 0,
                       img);
     next_c += img.width();
@@ -372,6 +446,26 @@ void draw_number(cimg_t *pimg, int col, int row, const char *str, const char *c)
   }
 }
 
+void draw_number_raw(char *raw, int col, int row, const char *str, unsigned char *color)
+{
+  if(numbers.empty()) {
+    init_number_text("./");
+  }  
+
+  mug_sprite_t *digits = get_raw_numbers(color);
+
+  char *p = (char*)str;
+  int next_c = col;
+
+  while('0' <= *p && *p <= '9' && next_c < MAX_COLS) {
+    mug_sprite_t *d = &digits[*p - '0'];
+    raw_draw_sprite(raw, next_c, row, d);
+    next_c += d->width;
+    next_c++;
+    p++;
+  }
+}
+
 void resize(cimg_t &img, int new_col, int new_row)
 {
   img.resize(new_col, new_row, -100);
@@ -385,6 +479,16 @@ void mug_draw_number_str_cimg(cimg_handle_t img, int col, int row, const char *s
   draw_number((cimg_t *)img, col, row, str, c);
 }
 
+void mug_draw_number_str_raw(char *raw, int col, int row, const char *str, const char* c)
+{
+  draw_number_raw(raw, col, row, str, color_to_rgb(c));
+}
+
+int mug_cimg_to_sprite(cimg_handle_t cimg, mug_sprite_t *sprite)
+{
+  return cimg_to_sprite(*(cimg_t*)cimg, sprite, false);
+}
+
 void mug_number_text_shape(int *width, int *height)
 {
   if(numbers.empty()) {
@@ -474,28 +578,174 @@ void closeFreetype(
   FT_Done_FreeType(ftlib);
 }
 
+/*
+ glyph cache: glyphs are rendered once per (code, size, color) and kept
+ as coverage for blending onto images plus thresholded to the display's
+ 3-bit color for packed buffers, least recently used dropped
+ */
+#define GLYPH_CACHE_SIZE 256
+
+typedef unsigned long long glyph_key_t;
+
+typedef struct _glyph_t {
+  int width, rows;
+  vector<unsigned char> coverage; // 0 transparent to 255 opaque
+  vector<unsigned char> bits;     // rgb bits per pixel drawn on black, 0 is transparent
+} glyph_t;
+
+typedef list<pair<glyph_key_t, glyph_t> >    glyph_lru_t;
+typedef map<glyph_key_t, glyph_lru_t::iterator> glyph_map_t;
+
+static glyph_lru_t glyph_lru;
+static glyph_map_t glyph_map;
+static int         glyph_pixel_size = 0;
+
+void clear_glyph_cache()
+{
+  glyph_lru.clear();
+  glyph_map.clear();
+  glyph_pixel_size = 0;
+}
+
+// FreeType only, glyphs already cached (e.g. from a font pack) stay valid
+void load_font_face()
+{
+  disp_font = (char*)mug_query_config_string(CONFIG_FONT);
+  initFreetype(ftlib, face, disp_font);
+  glyph_pixel_size = 0;
+}
+
+void init_font_face()
+{
+  load_font_face();
+  clear_glyph_cache();
+}
+
+void render_glyph(FT_Face& face, FT_ULong symbol, int heightText, unsigned char fontColor[], glyph_t *glyph)
+{
+  if(glyph_pixel_size != heightText) {
+    FT_Set_Pixel_Sizes(face, 0, heightText);
+    glyph_pixel_size = heightText;
+  }
+
+  if(FT_Load_Char(face, symbol, FT_LOAD_RENDER)){
+     throw "Error, glyph not load!! \n";
+  }
+
+  FT_Bitmap *bitmap = &(face->glyph->bitmap);
+
+  glyph->width = bitmap->width;
+  glyph->rows = bitmap->rows;
+  glyph->coverage.assign(bitmap->buffer, bitmap->buffer + bitmap->width * bitmap->rows);
+  glyph->bits.assign(bitmap->width * bitmap->rows, 0);
+
+  // same blending as drawing the glyph on black, then latched
+  for (int i = 0; i < glyph->bits.size(); ++i){
+    unsigned char glyphValue = bitmap->buffer[i];
+    float alpha = (255.0f - glyphValue) / 255.0f;
+
+    for (int c = 0; c < 3; c++){
+      unsigned char value = (float) glyphValue*fontColor[c]/(255.0f);
+      unsigned char pixel = (1.0 - alpha) * value;
+      if(pixel > LATCH)
+        glyph->bits[i] |= 1 << c;
+    }
+  }
+}
+
+bool load_pack_glyph(FT_ULong symbol, int heightText, unsigned char fontColor[], glyph_t *glyph)
+{
+  if(font_pack_height() != heightText)
+    return false;
+
+  const font_pack_glyph_t *g = font_pack_find(symbol);
+  if(g == NULL)
+    return false;
+
+  const unsigned char *bitmap = font_pack_bitmap(g);
+  int pitch = FONT_PACK_PITCH(g->width);
+  unsigned char color = rgb_2_raw(fontColor[0], fontColor[1], fontColor[2]);
+
+  glyph->width = g->width;
+  glyph->rows = g->rows;
+  glyph->coverage.assign(g->width * g->rows, 0);
+  glyph->bits.assign(g->width * g->rows, 0);
+
+  for (int y = 0; y < g->rows; ++y){
+    for (int x = 0; x < g->width; ++x){
+      if (bitmap[y * pitch + x / 8] & (0x80 >> (x % 8))) {
+        glyph->coverage[y * g->width + x] = 255;
+        glyph->bits[y * g->width + x] = color;
+      }
+    }
+  }
+
+  return true;
+}
+
+const glyph_t* get_glyph(FT_Face& face, FT_ULong symbol, int heightText, unsigned char fontColor[])
+{
+  glyph_key_t key = (glyph_key_t)symbol
+                    | ((glyph_key_t)(heightText & 0xff) << 32)
+                    | ((glyph_key_t)fontColor[0] << 40)
+                    | ((glyph_key_t)fontColor[1] << 48)
+                    | ((glyph_key_t)fontColor[2] << 56);
+
+  glyph_map_t::iterator found = glyph_map.find(key);
+
+  if(found != glyph_map.end()) {
+    glyph_lru.splice(glyph_lru.begin(), glyph_lru, found->second);
+    return &(found->second->second);
+  }
+
+  // rendered before it enters the cache, nothing below may touch the lru
+  glyph_t glyph;
+
+  if(!load_pack_glyph(symbol, heightText, fontColor, &glyph)) {
+    // fall back to FreeType for glyphs or sizes the pack lacks
+    if(face == NULL)
+      load_font_face();
+    render_glyph(face, symbol, heightText, fontColor, &glyph);
+  }
+
+  if(glyph_lru.size() >= GLYPH_CACHE_SIZE) {
+    glyph_map.erase(glyph_lru.back().first);
+    glyph_lru.pop_back();
+  }
+
+  glyph_lru.push_front(make_pair(key, glyph_t()));
+  glyph_lru.front().second.width = glyph.width;
+  glyph_lru.front().second.rows = glyph.rows;
+  glyph_lru.front().second.coverage.swap(glyph.coverage);
+  glyph_lru.front().second.bits.swap(glyph.bits);
+  glyph_map[key] = glyph_lru.begin();
+
+  return &(glyph_lru.front().second);
+}
+
+// blended over what is already in the image, as FreeType output always was
 void drawGlyph(
-  FT_GlyphSlot& glyphSlot,
+  const glyph_t *glyph,
   cimg_t& image,
   const int& shiftX,
   const int& shiftY,
-  unsigned char fontColor[] = NULL
+  unsigned char fontColor[]
 ){
-  unsigned char buff[] = {255, 255, 255};
-  if (fontColor == NULL){
-    fontColor = buff;
-  }
+  if (glyph->coverage.empty())
+    return;
 
-  float alpha = 0;
-  for (int y = 0; y < glyphSlot->bitmap.rows; ++y){
-    for (int x = 0; x < glyphSlot->bitmap.width; ++x){
+  const unsigned char *coverage = &(glyph->coverage[0]);
 
-      unsigned char glyphValue = glyphSlot->bitmap.buffer[y * glyphSlot->bitmap.width + x];
-      alpha = (255.0f - glyphValue) / 255.0f;
+  for (int y = 0; y < glyph->rows; ++y){
+    for (int x = 0; x < glyph->width; ++x, ++coverage){
+      if (*coverage == 0 || !image.containsXYZC(x + shiftX, y + shiftY))
+        continue;
+
+      float alpha = (255.0f - *coverage) / 255.0f;
 
       cimg_forC(image, c){
-        unsigned char value = (float) glyphValue*fontColor[c]/(255.0f);
-        image(x + shiftX, y + shiftY, c) = 
+        unsigned char value = (float) *coverage*fontColor[c]/(255.0f);
+        image(x + shiftX, y + shiftY, c) =
         alpha * image(x + shiftX, y + shiftY, c) + (1.0 - alpha) * value;
       }
     }
@@ -514,13 +764,14 @@ void drawText(
   unsigned char fontColor[] = NULL,
   const int separeteGlyphWidth = 1
 ){
+  unsigned char buff[] = {255, 255, 255};
+  if (fontColor == NULL){
+    fontColor = buff;
+  }
 
   width = 0;
   height = 0;
 
-  FT_Set_Pixel_Sizes(face, 0, heightText);
-  FT_GlyphSlot glyphSlot = face->glyph;  
-  
   int shiftX = leftTopX;
   int shiftY = 0;
   for(int numberSymbol = 0; numberSymbol < text.length(); ++numberSymbol){
@@ -534,22 +785,20 @@ void drawText(
       isSpace = true;
     }
 
-    if(FT_Load_Char(face, symbol, FT_LOAD_RENDER)){
-       throw "Error, glyph not load!! \n";
-    }
+    const glyph_t *glyph = get_glyph(face, symbol, heightText, fontColor);
 
-    shiftY = heightText - glyphSlot->bitmap.rows;
+    shiftY = heightText - glyph->rows;
     if(shiftY < 0)
       shiftY = 0;
    
     if(!isSpace){
-      drawGlyph(glyphSlot, image, shiftX, shiftY, fontColor);      
+      drawGlyph(glyph, image, shiftX, shiftY, fontColor);      
     }
-    shiftX += glyphSlot->bitmap.width + separeteGlyphWidth;
+    shiftX += glyph->width + separeteGlyphWidth;
 
     // update string img width/height
-    if(height < shiftY + glyphSlot->bitmap.rows) {
-      height = shiftY + glyphSlot->bitmap.rows;
+    if(height < shiftY + glyph->rows) {
+      height = shiftY + glyph->rows;
     }
     width = shiftX;
   }
@@ -566,43 +815,43 @@ wchar_t* get_wchar(char* c)
   return wc;
 }
 
-void mug_split_cimg(cimg_handle_t img, int step, cimg_vec_t &slices)
+// render the screen window whose first column is image column left,
+// everything outside the image is black
+void marquee_frame(const cimg_t *img, int left, char *buf)
 {
-  cimg_t *cimg = (cimg_t*)img;
-  
-  int width = cimg->width();
-
-  MUG_ASSERT(width >= SCREEN_WIDTH, "can not split image with width %d\n", width);
+  unsigned char planes[3][SCREEN_HEIGHT * SCREEN_WIDTH];
+  const unsigned char *ch[3];
+  int width = img->width();
+  int height = img->height() < SCREEN_HEIGHT ? img->height() : SCREEN_HEIGHT;
+
+  ch[0] = img->data(0, 0, 0, 0);
+  ch[1] = img->spectrum() >= 3 ? img->data(0, 0, 0, 1) : ch[0];
+  ch[2] = img->spectrum() >= 3 ? img->data(0, 0, 0, 2) : ch[0];
+
+  if(left >= 0 && left + SCREEN_WIDTH <= width && height == SCREEN_HEIGHT) {
+    pack_rgb_frame(ch[0] + left, ch[1] + left, ch[2] + left, width, buf);
+    return;
+  }
 
-  int times = (width - SCREEN_WIDTH + step - 1) / step + 1;
-  int real_height = cimg->height() < SCREEN_HEIGHT ? cimg->height() : SCREEN_HEIGHT;
+  memset(planes, 0, sizeof(planes));
 
-  int start, end;
+  int start = left < 0 ? -left : 0;
+  int end = width - left < SCREEN_WIDTH ? width - left : SCREEN_WIDTH;
 
-  for(int i = 0; i < times; i++) {
-    start = i * step;
-    end = (start + SCREEN_WIDTH - 1);
-    if (end >= width - 1) {
-      end = width - 1;
+  if(start < end) {
+    for(int c = 0; c < 3; c++) {
+      for(int r = 0; r < height; r++) {
+        memcpy(&planes[c][r * SCREEN_WIDTH + start], ch[c] + r * width + left + start, end - start);
+      }
     }
-
-    cimg_t crop = cimg->get_crop(start, 0, end, real_height - 1);
-    cimg_t canvas = cimg_t(SCREEN_WIDTH, SCREEN_HEIGHT, 1, 3, 0);
-    canvas.draw_image(0, 0, 0, 0, crop);
-    
-    slices.push_back(canvas);
   }
+
+  pack_rgb_frame(planes[0], planes[1], planes[2], SCREEN_WIDTH, buf);
 }
 
-bool check_and_sleep(int usec)
+bool is_marquee_stopped()
 {
-  if(text_disp_thread_hdl && __sync_fetch_and_add(&force_stop_disp, 0)) {
-    return true;
-  } else {
-    usleep(usec * 1000);
-  }
-  return false;
-
+  return text_disp_thread_hdl && __sync_fetch_and_add(&force_stop_disp, 0);
 }
 
 void* thread_entry(void *param)
@@ -650,19 +899,14 @@ void notify_new_disp()
 
 void mug_disp_cimg_marquee(handle_t handle, cimg_handle_t img, int interval, int repeat, int seamless)
 {
-  cimg_vec_t slices;
-
   cimg_t *cimg = (cimg_t*)img;
-  //enlarge the original image
+  // frames are windows on a virtual canvas with the image at offset,
+  // rendered one at a time when shown
   int step = 2, offset = 0;
   int large_size = cimg->width();
+  int num = 1;
 
-
-  if(seamless == MQ_NULL) {
-    cimg_t large(SCREEN_WIDTH, SCREEN_HEIGHT, 1, 3, 0);
-    large.draw_image(0, 0, 0, *cimg);
-    slices.push_back(large);
-  }  else {
+  if(seamless != MQ_NULL) {
 
     if(seamless & MQ_PROLOG) {
       if(cimg->width() < SCREEN_WIDTH) {
@@ -679,43 +923,35 @@ void mug_disp_cimg_marquee(handle_t handle, cimg_handle_t img, int interval, int
       large_size += SCREEN_WIDTH;
     }    
 
-    cimg_t large(large_size, SCREEN_HEIGHT, 1, 3, 0);
-    large.draw_image(offset, 0, 0, *cimg);
-
-    cimg = &large;
-
-    mug_split_cimg((cimg_handle_t)cimg, step, slices);
-  }
-
-  // transfer images to raw data
-  int num = slices.size(); 
-  char *buf = (char*)malloc(COMPRESSED_SIZE * num);
-  char *p = buf;
-
-  for(int i = 0; i < num; i++) {
-    mug_cimg_to_raw((cimg_handle_t)&slices[i], p);
-    p += COMPRESSED_SIZE;
+    if(large_size > SCREEN_WIDTH)
+      num = (large_size - SCREEN_WIDTH + step - 1) / step + 1;
   }
 
+  char buf[COMPRESSED_SIZE];
   int cnt = 0;
+  frame_sched_t sched;
 
   LOCK_(&marquee_mutex);
 
   reset_marquee();
+  sched_init(&sched, interval);
   while(repeat < 0 || cnt < repeat) {
-    p = buf;
     for(int i = 0; i < num; i++) {
 
-      mug_disp_raw_N(handle, p, 1, 0);
-      //mug_disp_raw(handle, p);
-      if(check_and_sleep(interval)) {
+      if(is_marquee_stopped()) {
+        sched_finish(&sched, false);
         goto end;
       }
-      p += COMPRESSED_SIZE ;
+
+      if(sched_next(&sched)) {
+        marquee_frame(cimg, i * step - offset, buf);
+        mug_disp_raw_N(handle, buf, 1, 0);
+      }
     }
     //mug_disp_raw_N(handle, buf, num, interval);
     cnt++;
   }
+  sched_finish(&sched);
 end:
   UNLOCK_(&marquee_mutex);
 }
@@ -769,12 +1005,60 @@ void mug_draw_text_cimg(cimg_handle_t img,
   
   unsigned char *rgb = color_to_rgb(color);
 
-  if(face == NULL)
+  if(face == NULL && font_pack_height() == 0)
     mug_init_font(NULL);
 
   drawText(face, *(cimg_t*)img, height, str, col, row, *str_width, *str_height, rgb);
 }
 
+// text drawn straight into a packed buffer, same layout as drawText
+int draw_text_raw(char *raw, int col, int row, const char* text, unsigned char *rgb, int height)
+{
+  wchar_t *wc = utf8_to_unicode_wchar(text);
+  std::wstring str = wc;
+  free(wc);
+
+  if(face == NULL && font_pack_height() == 0)
+    mug_init_font(NULL);
+
+  int shiftX = col;
+  int shiftY;
+  uint64_t bits, mask;
+
+  for(int i = 0; i < str.length() && shiftX < MAX_COLS; i++) {
+    FT_ULong symbol = str[i];
+    bool isSpace = (symbol == ' ');
+
+    const glyph_t *glyph = get_glyph(face, isSpace ? 'a' : symbol, height, rgb);
+
+    shiftY = height - glyph->rows;
+    if(shiftY < 0)
+      shiftY = 0;
+
+    for(int y = 0; !isSpace && y < glyph->rows; y++) {
+      const unsigned char *p = &(glyph->bits[y * glyph->width]);
+      bits = 0;
+      mask = 0;
+      for(int x = 0; x < glyph->width && x < MAX_COLS; x++) {
+        if(p[x]) {
+          bits |= (uint64_t)p[x] << (4 * x);
+          mask |= 0xfULL << (4 * x);
+        }
+      }
+      raw_put_bits(raw, shiftX, row + shiftY + y, bits, mask);
+    }
+
+    shiftX += glyph->width + 1;
+  }
+
+  return shiftX - col;
+}
+
+int mug_draw_text_raw(char *raw, int col, int row, const char* text, const char* color, int height)
+{
+  return draw_text_raw(raw, col, row, text, color_to_rgb(color), height);
+}
+
 cimg_handle_t mug_new_text_cimg(const char* text, const char* color)
 {
   wchar_t *wc = utf8_to_unicode_wchar(text);
@@ -809,13 +1093,22 @@ void img_env_init()
 
 void mug_init_font(char *font)
 {
-  if(!disp_font) {
+  static bool env_ready = false;
+
+  if(!env_ready) {
     img_env_init();
+    env_ready = true;
   }
 
   if(font == NULL || strlen(font) == 0) {
-    disp_font = (char*)mug_query_config_string(CONFIG_FONT);
-    initFreetype(ftlib, face, disp_font);
+    // a precompiled font pack avoids loading FreeType and the font
+    const char *pack = mug_query_config_string(CONFIG_FONT_PACK);
+    if(strlen(pack) != 0 && font_pack_open(pack) == 0) {
+      clear_glyph_cache();
+      return;
+    }
+
+    init_font_face();
   }
 
 }
@@ -11,6 +11,7 @@
 #include <errno.h>
 #include <io.h>
 #include <mug.h>
+#include <res_manager.h>
 
 
 #define TP_DEV_PATH         "/dev/input/event1"
@@ -192,6 +193,82 @@ void mug_stop_mcu_disp(handle_t handle)
   stop_mcu_disp(handle, 40);
 }
 
+#define UPLOAD_FRAME_DURATION 100 // ms, when no durations are given
+
+mug_error_t mug_upload_animation(handle_t handle, char *raw, int number, int *durations)
+{
+#ifdef USE_IOHUB
+  // iohubd has no frame memory commands
+  return ERROR_NOT_AVAILABLE;
+#else
+  int fd = (int)handle;
+  char *p = raw;
+  mug_error_t err = ERROR_NONE;
+
+  if(raw == NULL || number <= 0 || number > MAX_LED_FRAMES)
+    return MUG_ERROR_INVALID_ARG;
+
+  int semResource = resource_init(LOCK_DISPLAY_TOUCH);
+  resource_wait(semResource);
+
+  // playback stops here, the panel no longer shows the shared frame buffer
+  mug_disp_invalidate(handle);
+
+  LedFrame_Set(fd, FRAME_ACTIVE_MASK, 0);
+
+  for(BYTE frameId = 0; frameId < MAX_LED_FRAMES && err == ERROR_NONE; frameId++) {
+    // frames are disabled while being written, unused ones stay disabled
+    err = LedFrame_Set(fd, FRAME_ENABLE_MASK, frameId);
+    if(frameId >= number)
+      continue;
+
+    for(BYTE rowId = 0; rowId < MAX_ROWS && err == ERROR_NONE; rowId++) {
+      err = LedFrame_Set_Row(fd, frameId, rowId, p);
+      p += BYTES_PER_ROW;
+    }
+
+    if(err == ERROR_NONE)
+      err = LedFrame_Set_Duration(fd, frameId, durations != NULL ? durations[frameId] : UPLOAD_FRAME_DURATION);
+
+    if(err == ERROR_NONE)
+      err = LedFrame_Set(fd, FRAME_ENABLE_MASK | FRAME_ENABLE_FLAG, frameId);
+  }
+
+  resource_post(semResource);
+
+  return err;
+#endif
+}
+
+static mug_error_t set_uploaded_active(handle_t handle, BOOL flags)
+{
+#ifdef USE_IOHUB
+  return ERROR_NOT_AVAILABLE;
+#else
+  int semResource = resource_init(LOCK_DISPLAY_TOUCH);
+  resource_wait(semResource);
+
+  // the display changes hands, the shared frame buffer is stale either way
+  mug_disp_invalidate(handle);
+
+  mug_error_t err = LedFrame_Set((int)handle, flags, 0);
+
+  resource_post(semResource);
+
+  return err;
+#endif
+}
+
+mug_error_t mug_play_uploaded(handle_t handle)
+{
+  return set_uploaded_active(handle, FRAME_ACTIVE_MASK | FRAME_ACTIVE_FLAG);
+}
+
+mug_error_t mug_stop_uploaded(handle_t handle)
+{
+  return set_uploaded_active(handle, FRAME_ACTIVE_MASK);
+}
+
 void mug_shut_down_mcu(int sec)
 {
 
@@ -4,152 +4,34 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <math.h>
-
-#include <list>
-using namespace std;
+#include <time.h>
+#include <pthread.h>
 
 #include <iohub_client.h>
 #include <mug.h>
+#include <frame_sched.h>
+#include <spsc_ring.h>
+#include <mono_time.h>
 
 #define MOTION_DEFAULT_INTERVAL 200
+#define MOTION_DEFAULT_RATE     200   // Hz, batch sampling
 #define MPU_ACC_G               16384
 
 #ifndef USE_IOHUB
 #include <io.h>
 #endif
 
-void mix(float gx, float gy, float gz, float ax, float ay, float az)  
-{
-  const float Kp= 3.0f;
-  const float Ki= 0.0005f;
-  const float halfT=0.16f;
-  const float angl2rad=3.14/180;
-  const float rad2angl=180/3.14;
-  static float q0 = 1, q1 = 0, q2 = 0, q3 = 0;
-  static float exInt = 0, eyInt = 0, ezInt = 0;
-  float  angle_by_mix_x=0, angle_by_mix_y=0, angle_by_mix_z=0;
-  float norm;
-  float vx, vy, vz;
-  float ex, ey, ez;
-  float t11;
-  float t12;
-  float t13;
-  float t23;
-  float t33;
-
-  norm = sqrt(ax*ax + ay*ay + az*az);
-  ax = ax / norm;
-  ay = ay / norm;
-  az = az / norm;
-
-  vx = 2*(q1*q3 - q0*q2);
-  vy = 2*(q0*q1 + q2*q3);
-  vz = q0*q0 - q1*q1 - q2*q2 + q3*q3;
-
-  ex = (ay*vz - az*vy);
-  ey = (az*vx - ax*vz);
-  ez = (ax*vy - ay*vx);
-  exInt = exInt + ex*Ki;
-  eyInt = eyInt + ey*Ki;
-  ezInt = ezInt + ez*Ki;
-
-  gx = gx + Kp*ex + exInt;
-  gy = gy + Kp*ey + eyInt;
-  gz = gz + Kp*ez + ezInt;
-
-  q0 = q0 + (-q1*gx - q2*gy - q3*gz)*halfT;
-  q1 = q1 + (q0*gx + q2*gz - q3*gy)*halfT;
-  q2 = q2 + (q0*gy - q1*gz + q3*gx)*halfT;
-  q3 = q3 + (q0*gz + q1*gy - q2*gx)*halfT;
-
-  norm = sqrt(q0*q0 + q1*q1 + q2*q2 + q3*q3);
-  q0 = q0 / norm;
-  q1 = q1 / norm;
-  q2 = q2 / norm;
-  q3 = q3 / norm;
-
-  t11=q0*q0+q1*q1-q2*q2-q3*q3;
-  t12=2.0*(q1*q2+q0*q3);
-  t13=2.0*(q1*q3-q0*q2);
-  t23=2.0*(q2*q3+q0*q1);
-  t33=q0*q0-q1*q1-q2*q2+q3*q3;
-
-  angle_by_mix_x = atan2(t23,t33);
-  angle_by_mix_y = -asin(t13);
-  angle_by_mix_z = atan2(t12,t11);
-
-  if (angle_by_mix_z < 0){
-    angle_by_mix_z += 360*angl2rad;
-  }
-
-  angle_by_mix_x *=  rad2angl;
-  angle_by_mix_y *=  rad2angl;
-  angle_by_mix_z *=  rad2angl;
-// printf("\n  angle_by_mix_x = %d, angle_by_mix_y = %d, angle_by_mix_z = %d ", (int)angle_by_mix_x, (int)angle_by_mix_y, (int)angle_by_mix_z);
-}
-
-
-
+// tilt of each axis against the horizontal plane from the accelerometer
+// alone, see mug_fusion_t for an attitude that also uses the gyro
 void motion_data_to_angel(int ax, int ay, int az, int gx, int gy, int gz,
                         float *angle_x, float *angle_y, float *angle_z)
 {
-  //printf("async ax:%8d, ay:%8d, az:%8d, gx:%8d, gy:%8d, gz:%8d\n",
-    //      ax, ay, az, gx, gy, gz);
-  static struct  timeval  nowtime;
-  static struct  timeval  lasttime;
-  float timer;
-
-  const float acc_r=0.00006103;
-  const float gyro_r=0.0001335;
-  const float rad2angl = 57.3;
-  float acc_x, acc_y, acc_z;
-  float gyro_x, gyro_y, gyro_z;
-  float acc_offset_x, acc_offset_y, acc_offset_z;
-  float gyro_offset_x, gyro_offset_y, gyro_offset_z;
-  float  angle_by_acc_x, angle_by_acc_y, angle_by_acc_z;
-  static  float  angle_by_gyro_x, angle_by_gyro_y, angle_by_gyro_z;
-  static  float  angle_by_gyro_xx, angle_by_gyro_yy, angle_by_gyro_zz;
-
-  gx += 200;    //offset
-  gy -= 100;
-  gz -= 80;
-  acc_x = (float)ax*acc_r;
-  acc_y = (float)ay*acc_r;
-  acc_z = (float)az*acc_r;
-  gyro_x = (float)gx*gyro_r;
-  gyro_y = (float)gy*gyro_r;
-  gyro_z = (float)gz*gyro_r;
-
-  if(gyro_y > -0.01 && gyro_x < 0.01)
-    gyro_x = 0;
-
-  if(gyro_y > -0.01 && gyro_y < 0.01)
-    gyro_y = 0;
-
-  if(gyro_z > -0.01 && gyro_z < 0.01)
-    gyro_z = 0;
-
-  angle_by_acc_x= atan(acc_x/sqrt(acc_z*acc_z + acc_y*acc_y))*rad2angl;
-  angle_by_acc_y= atan(acc_y/sqrt(acc_x*acc_x + acc_z*acc_z))*rad2angl;
-  angle_by_acc_z= atan(acc_z/sqrt(acc_x*acc_x + acc_y*acc_y))*rad2angl;
-
-  gettimeofday(&nowtime,NULL);
-  timer = 1000000 * (-lasttime.tv_sec+nowtime.tv_sec)- lasttime.tv_usec+nowtime.tv_usec;
-  timer /= 1000000;
-
-  angle_by_gyro_x = (angle_by_gyro_x + gyro_x * timer);
-  angle_by_gyro_y = (angle_by_gyro_y + gyro_y * timer);
-  angle_by_gyro_z = (angle_by_gyro_z + gyro_z * timer);
-  lasttime = nowtime;
-  angle_by_gyro_xx = rad2angl*angle_by_gyro_x;
-  angle_by_gyro_yy = rad2angl*angle_by_gyro_y;
-  angle_by_gyro_zz = rad2angl*angle_by_gyro_z;
-  //printf("\n  angle_by_acc_x = %f, angle_by_acc_y = %f, angle_by_acc_z = %f ", angle_by_acc_x, angle_by_acc_y, angle_by_acc_z);
-
-  *angle_x = angle_by_acc_x;
-  *angle_y = angle_by_acc_y;
-  *angle_z = angle_by_acc_z;
+  const float rad2angl = 57.3f;
+  float acc_x = ax, acc_y = ay, acc_z = az;
 
+  *angle_x = atanf(acc_x / sqrtf(acc_z * acc_z + acc_y * acc_y)) * rad2angl;
+  *angle_y = atanf(acc_y / sqrtf(acc_x * acc_x + acc_z * acc_z)) * rad2angl;
+  *angle_z = atanf(acc_z / sqrtf(acc_x * acc_x + acc_y * acc_y)) * rad2angl;
 }
 
 
@@ -173,15 +55,105 @@ typedef struct _req_motion_t {
 
 
 static req_motion_t *reqm = NULL;
-typedef list<int> acc_list_t;
+
+// batch sampling: a reader thread pushes timestamped samples on a
+// single-producer/single-consumer ring, the loop thread hands them out
+#define MOTION_RING_SIZE 1024   // power of 2
+#define MOTION_BATCH_MAX 256
+
+typedef struct _motion_batch_t {
+  motion_batch_cb_t cb;
+  int               max_batch;
+  long long         max_latency;  // us
+  int               rate;         // Hz
+  volatile bool     running;
+  pthread_t         thread;
+  uv_async_t        async;
+
+  // newest sample, for the timer callbacks while the reader owns the device
+  pthread_mutex_t   latest_mutex;
+  motion_data_t     latest;
+  bool              has_latest;   // false until the reader's first sample
+} motion_batch_t;
+
+static spsc_ring_t<motion_sample_t, MOTION_RING_SIZE> motion_ring;
+static motion_batch_t batch;
+
+static void uv_motion_batch(uv_async_t *handle, int status)
+{
+  motion_sample_t samples[MOTION_BATCH_MAX];
+  int n;
+
+  // cb is cleared by mug_motion_batch_off, maybe from inside cb itself
+  while(batch.cb != NULL && (n = ring_pop(&motion_ring, samples, batch.max_batch)) > 0)
+    batch.cb(samples, n);
+}
+
+static void* motion_sampler(void *arg)
+{
+  handle_t handle = (handle_t)arg;
+  frame_sched_t sched;
+  motion_sample_t s;
+  long long pending_since = 0;
+  int pending = 0;
+
+  sched_init_ns(&sched, 1000000000LL / batch.rate);
+
+  while(batch.running) {
+    // a slot missed entirely is skipped, not made up for
+    if(!sched_next(&sched))
+      continue;
+
+    if(mug_read_motion(handle, &s.data) != ERROR_NONE)
+      continue;
+
+    s.stamp = now_us();
+
+    pthread_mutex_lock(&batch.latest_mutex);
+    batch.latest = s.data;
+    batch.has_latest = true;
+    pthread_mutex_unlock(&batch.latest_mutex);
+
+    if(!ring_push(&motion_ring, &s))
+      continue;
+
+    if(pending++ == 0)
+      pending_since = s.stamp;
+
+    if(pending >= batch.max_batch || s.stamp - pending_since >= batch.max_latency) {
+      uv_async_send(&batch.async);
+      pending = 0;
+    }
+  }
+
+  return NULL;
+}
+
+// sliding window over the last shake.length samples; every sample's sign
+// on each axis (beyond least_acc from a slow baseline that takes out
+// gravity) is kept so the oldest one can be taken back out of the counters
+#define SHAKE_AXES        3
+#define SHAKE_WINDOW_MAX  1024
+#define SHAKE_BASE_SHIFT  4     // baseline moves 1/16 of the way per sample
+
+typedef struct _shake_axis_t {
+  signed char sign[SHAKE_WINDOW_MAX];
+  int         pos, neg;
+  int         base;
+} shake_axis_t;
 
 typedef struct _shake_t {
 
-  acc_list_t x_trace;
-  acc_list_t y_trace;
-  
+  shake_axis_t axis[SHAKE_AXES];
+  int head;        // next window slot
+  int count;       // samples in the window
+  bool primed;     // baselines are set
+
+  bool shaking;
+  int quiet;       // samples in a row without shake
+  int release;     // quiet ms before a stop is reported
+
   int period;
-  int count;
   int length;
   int least_times;
 
@@ -194,6 +166,17 @@ static shake_t shake;
 #define DEFAULT_SHAKE_PERIOD 1000
 #define DEFAULT_SHAKE_TIMES  1
 #define DEFAULT_SHAKE_SENSITIVITY 10
+#define DEFAULT_SHAKE_RELEASE 0
+
+void reset_shake_window()
+{
+  memset(shake.axis, 0, sizeof(shake.axis));
+  shake.head = 0;
+  shake.count = 0;
+  shake.primed = false;
+  shake.shaking = false;
+  shake.quiet = 0;
+}
 
 void mug_set_shake(int period, int times) 
 {
@@ -210,16 +193,19 @@ void mug_set_shake(int period, int times)
     shake.length = wanted_times;
     reqm->interval = period / wanted_times;
   }
+
+  if(shake.length > SHAKE_WINDOW_MAX)
+    shake.length = SHAKE_WINDOW_MAX;
+
+  reset_shake_window();
 }
 
 void init_shake()
 {
-  shake.x_trace.clear();
-  shake.y_trace.clear();
-  shake.count = 0;
   shake.least_times = 0;
   shake.length = 0;
   shake.period = 0;
+  shake.release = DEFAULT_SHAKE_RELEASE;
   shake.least_acc = MPU_ACC_G / DEFAULT_SHAKE_SENSITIVITY;
 
   mug_set_shake(DEFAULT_SHAKE_PERIOD, DEFAULT_SHAKE_TIMES);
@@ -230,86 +216,79 @@ int get_shake_interval()
   return shake.period / (2 * 2 * shake.least_times);
 }
 
-bool is_shake(acc_list_t *trace, int least_times, int least_acc) 
+// slide one axis' window by a sample, returns true if it shakes
+bool shake_axis_add(shake_axis_t *axis, int v, bool full)
 {
-  int neg = 0, pos = 0;
+  int d = v - axis->base;
+  signed char sign = 0;
 
-  for(acc_list_t::iterator itr = trace->begin();
-      itr != trace->end();
-      itr++) {
+  axis->base += d >> SHAKE_BASE_SHIFT;
 
-    if(-1 * least_acc <= *itr && *itr <= least_acc)
-      continue;
+  if(d > shake.least_acc)
+    sign = 1;
+  else if(d < -shake.least_acc)
+    sign = -1;
 
-    if(*itr > 0)
-      pos++;
-    else
-      neg++;
+  if(full) {
+    signed char old = axis->sign[shake.head];
+    axis->pos -= (old > 0);
+    axis->neg -= (old < 0);
   }
 
-  int min = (pos > neg) ? neg : pos;
+  axis->sign[shake.head] = sign;
+  axis->pos += (sign > 0);
+  axis->neg += (sign < 0);
+
+  int min = (axis->pos > axis->neg) ? axis->neg : axis->pos;
 
-  return (min >= least_times);
+  return (min >= shake.least_times);
 }
 
-void print_shake_trace(acc_list_t *trace)
+void detect_shake(int ax, int ay, int az, motion_shake_cb_t scb)
 {
-  printf("[ ");
-
-  for(acc_list_t::iterator itr = trace->begin();
-      itr != trace->end();
-      itr++) {
-    printf("%d ", *itr);
+  int v[SHAKE_AXES] = { ax, ay, az };
+  bool full = (shake.count == shake.length);
+  bool this_shaking = false;
+
+  if(!shake.primed) {
+    for(int i = 0; i < SHAKE_AXES; i++)
+      shake.axis[i].base = v[i];
+    shake.primed = true;
   }
 
-  printf("]");
-}
+  for(int i = 0; i < SHAKE_AXES; i++) {
+    if(shake_axis_add(&shake.axis[i], v[i], full))
+      this_shaking = true;
+  }
 
-void detect_shake(int ax, int ay, int az, motion_shake_cb_t scb)
-{
-  static bool is_shaking = false;
+  shake.head = (shake.head + 1) % shake.length;
+  if(!full)
+    shake.count++;
 
 #ifdef DEBUG_SHAKE
-  printf("X: ");
-  print_shake_trace(&shake.x_trace);
-  printf("\n");
-
-  printf("Y: ");
-  print_shake_trace(&shake.y_trace);
+  for(int i = 0; i < SHAKE_AXES; i++)
+    printf("%c: +%d -%d ", 'X' + i, shake.axis[i].pos, shake.axis[i].neg);
   printf("\n");
 #endif
 
-  if(shake.count < shake.length) {
-    shake.x_trace.push_back(ax);
-    shake.y_trace.push_back(ay);
-    shake.count++;
-    return;
-  }
-
-  bool this_shaking = (is_shake(&(shake.x_trace), shake.least_times, shake.least_acc) 
-                      || is_shake(&(shake.y_trace), shake.least_times, shake.least_acc));
-
-  if(is_shaking) {
-    if(this_shaking) {
-      // continue shaking 
-    } else {
-      is_shaking = false;
-      scb(false);
-    }
-  } else {
-    if(this_shaking) {
-      is_shaking = true;
+  if(this_shaking) {
+    shake.quiet = 0;
+    if(!shake.shaking) {
+      shake.shaking = true;
       scb(true);
-    } else {
-      // nothing to do
+    }
+  } else if(shake.shaking) {
+    // stop once the window is clear and stays so for shake.release ms
+    if(++shake.quiet * reqm->interval > shake.release) {
+      shake.shaking = false;
+      scb(false);
     }
   }
+}
 
-  // clear shake traces 
-  shake.x_trace.clear();
-  shake.y_trace.clear();
-  shake.count = 0;
-
+void mug_config_shake_release(handle_t handle, int release)
+{
+  shake.release = release;
 }
 
 void mug_config_shake(handle_t handle, int period, int times)
@@ -321,7 +300,16 @@ void run_motion_timer(uv_timer_t *req, int status)
 {
   req_motion_t *motion = (req_motion_t*)(req->data); 
   motion_data_t *data = &(motion->data);
-  motion->error = mug_read_motion(motion->handle, &(motion->data));  
+
+  if(batch.running) {
+    pthread_mutex_lock(&batch.latest_mutex);
+    motion->data = batch.latest;
+    // nothing to report until the reader has published a sample
+    motion->error = batch.has_latest ? ERROR_NONE : ERROR_NOT_AVAILABLE;
+    pthread_mutex_unlock(&batch.latest_mutex);
+  } else {
+    motion->error = mug_read_motion(motion->handle, &(motion->data));
+  }
 
   if(motion->error == ERROR_NONE && status == 0) {
 
@@ -365,6 +353,46 @@ void mug_motion_shake_on(handle_t handle, motion_shake_cb_t scb)
   init_shake();
 }
 
+void mug_motion_batch_on(handle_t handle, motion_batch_cb_t cb, int max_batch, int max_latency)
+{
+  MUG_ASSERT(0 < max_batch && max_batch <= MOTION_BATCH_MAX, "batch size %d out of 1..%d\n", max_batch, MOTION_BATCH_MAX);
+
+  batch.cb = cb;
+  batch.max_batch = max_batch;
+  batch.max_latency = max_latency * 1000LL;
+}
+
+// stop the reader thread, samples not delivered yet are dropped; call it
+// on the motion loop's thread, a batch callback is fine
+void mug_motion_batch_off(handle_t handle)
+{
+  if(batch.running) {
+    batch.running = false;
+    pthread_join(batch.thread, NULL);
+    uv_unref((uv_handle_t*)&batch.async);
+  }
+
+  batch.cb = NULL;
+
+  pthread_mutex_lock(&batch.latest_mutex);
+  batch.has_latest = false;
+  pthread_mutex_unlock(&batch.latest_mutex);
+
+  // the reader is gone, the consumer may take the producer's side
+  ring_clear(&motion_ring);
+}
+
+void mug_set_motion_rate(handle_t handle, int rate)
+{
+  MUG_ASSERT(0 < rate && rate <= 1000, "motion rate %d out of 1..1000 Hz\n", rate);
+  batch.rate = rate;
+}
+
+unsigned int mug_motion_dropped(handle_t handle)
+{
+  return ring_overflow(&motion_ring);
+}
+
 void mug_run_motion_watcher(handle_t handle)
 {
   if(reqm->scb) {
@@ -373,7 +401,16 @@ void mug_run_motion_watcher(handle_t handle)
     }
   }
 
-  uv_timer_start(&motion_timer, run_motion_timer, 0, reqm->interval);
+  if(batch.cb != NULL && !batch.running) {
+    batch.running = true;
+    uv_ref((uv_handle_t*)&batch.async);
+    int err = pthread_create(&batch.thread, NULL, motion_sampler, (void*)handle);
+    MUG_ASSERT(!err, "can not create motion sampler thread\n");
+  }
+
+  // the timer is only needed for the per-tick callbacks
+  if(reqm->cb != NULL || reqm->acb != NULL || reqm->scb != NULL)
+    uv_timer_start(&motion_timer, run_motion_timer, 0, reqm->interval);
 #ifndef BUILD_NODE_ADDON
   uv_run(motion_loop, UV_RUN_DEFAULT);
 #endif
@@ -394,6 +431,12 @@ void motion_init(handle_t handle)
   motion_timer.data = (void*)reqm;
 
   reqm->interval = MOTION_DEFAULT_INTERVAL;
+
+  batch.rate = MOTION_DEFAULT_RATE;
+  pthread_mutex_init(&batch.latest_mutex, NULL);
+  uv_async_init(motion_loop, &batch.async, uv_motion_batch);
+  // only keeps the loop alive once sampling starts
+  uv_unref((uv_handle_t*)&batch.async);
 }
 #else
 
@@ -0,0 +1,97 @@
+#include <string.h>
+#include <pack.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// 1 if a channel value lights the led, see rgb_2_raw
+static unsigned char latch_lut[256];
+static bool lut_ready = false;
+
+static void init_latch_lut()
+{
+  for(int v = 0; v < 256; v++)
+    latch_lut[v] = (v > LATCH);
+
+  lut_ready = true;
+}
+
+static void pack_row_c(const unsigned char *r, const unsigned char *g, const unsigned char *b, unsigned char *out)
+{
+  unsigned char lo, hi;
+
+  for(int c = 0; c < SCREEN_WIDTH; c += 2) {
+    lo = latch_lut[r[c]]     | (latch_lut[g[c]] << 1)     | (latch_lut[b[c]] << 2);
+    hi = latch_lut[r[c + 1]] | (latch_lut[g[c + 1]] << 1) | (latch_lut[b[c + 1]] << 2);
+    *out++ = lo | (hi << 4);
+  }
+}
+
+#ifdef __SSE2__
+// a row of 16 pixels is exactly one register per channel
+static void pack_row_sse2(const unsigned char *r, const unsigned char *g, const unsigned char *b, unsigned char *out)
+{
+  const __m128i latch = _mm_set1_epi8(LATCH);
+  const __m128i zero  = _mm_setzero_si128();
+  const __m128i ones  = _mm_set1_epi8(-1);
+
+  // v > LATCH  <=>  saturated (v - LATCH) != 0
+  __m128i mr = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_subs_epu8(_mm_loadu_si128((const __m128i*)r), latch), zero), ones);
+  __m128i mg = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_subs_epu8(_mm_loadu_si128((const __m128i*)g), latch), zero), ones);
+  __m128i mb = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_subs_epu8(_mm_loadu_si128((const __m128i*)b), latch), zero), ones);
+
+  __m128i nib = _mm_or_si128(_mm_and_si128(mr, _mm_set1_epi8(1)),
+                _mm_or_si128(_mm_and_si128(mg, _mm_set1_epi8(2)),
+                             _mm_and_si128(mb, _mm_set1_epi8(4))));
+
+  // each 16 bit lane holds pixel 2j in the low byte, 2j+1 in the high byte
+  __m128i packed = _mm_and_si128(_mm_or_si128(nib, _mm_srli_epi16(nib, 4)), _mm_set1_epi16(0xff));
+
+  _mm_storel_epi64((__m128i*)out, _mm_packus_epi16(packed, zero));
+}
+#endif
+
+void pack_rgb_frame(const unsigned char *r, const unsigned char *g, const unsigned char *b,
+                    int stride, char *buf)
+{
+  unsigned char *out = (unsigned char*)buf;
+
+  if(!lut_ready)
+    init_latch_lut();
+
+  for(int row = 0; row < SCREEN_HEIGHT; row++) {
+#ifdef __SSE2__
+    pack_row_sse2(r, g, b, out);
+#else
+    pack_row_c(r, g, b, out);
+#endif
+    r += stride;
+    g += stride;
+    b += stride;
+    out += MAX_COMPRESSED_COLS;
+  }
+}
+
+// write the masked pixels of bits, whose pixel 0 lands on col, clipped
+void raw_put_bits(char *raw, int col, int row, uint64_t bits, uint64_t mask)
+{
+  if(row < 0 || row >= MAX_ROWS || col >= MAX_COLS || col <= -MAX_COLS)
+    return;
+
+  if(col >= 0) {
+    mask <<= 4 * col;
+    bits <<= 4 * col;
+  } else {
+    mask >>= -4 * col;
+    bits >>= -4 * col;
+  }
+
+  raw_set_row(raw, row, (raw_get_row(raw, row) & ~mask) | (bits & mask));
+}
+
+void raw_draw_sprite(char *raw, int col, int row, const mug_sprite_t *sprite)
+{
+  for(int r = 0; r < sprite->height; r++)
+    raw_put_bits(raw, col, row + r, sprite->row[r], sprite->mask[r]);
+}
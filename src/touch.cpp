@@ -7,14 +7,20 @@
 
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
 
-#include <list>
-#include <vector>
 #include <map>
 
 #include <iohub_client.h>
 #include <mug.h>
 #include <config.h>
+#include <touch_rec.h>
+#include <spsc_ring.h>
+#include <mono_time.h>
 #ifndef USE_IOHUB
 #include <io.h>
 #endif
@@ -36,37 +42,67 @@ using namespace std;
 #define DEV_INPUT_EVENT "/dev/input"
 #define EVENT_DEV_NAME  "event"
 
+// path and identity of the last panel found, skips the scan next time
+#define TOUCH_DEV_CACHE "/tmp/smart_mug_touch_dev"
+
 #define MT_INVALID_VALUE -1
 
-#define TOUCH_TRACE_NUM 2
+// fingers tracked at once, more if the panel reports more slots
+#define TOUCH_TRACE_NUM 10
 
-#define TOUCH_READ_NUM 2
+// events drained per read()
+#define TOUCH_READ_NUM 64
 
 #define TRACE_MIN_NUM 5
 
-#define HOLD_MIN_NUM  30
+// ms a still finger has to stay down to be a hold
+#define HOLD_MIN_MS   500
 
 #define HOLD_MIN_PIXEL 2
 
-#define IS_TWO_FINGER(tk) (tk[0]->size() != 0 && tk[1]->size() != 0)
+// a fast flick only has to cover half the swipe distance
+#define FLING_MIN_SPEED 1500  // px/s in touch coordinates
+
 
-#define TOUCH_IDLE_TIME 10
-#define TOUCH_BUSY_TIME 1
+// ms without events that ends a touch
+#define TOUCH_IDLE_TIMEOUT 100
 
 #define SCALE_X(x) ((x) / TOUCH_WIDTH_SCALE)
 #define SCALE_Y(y) ((y) / TOUCH_HEIGHT_SCALE)
 
 //#define DEBUG
 
-typedef list<input_event>              event_list_t;
-typedef list<touch_point_t>            touch_trace_t;
-typedef vector<touch_trace_t*>         touch_track_t;
+// running summary of one finger's trace, updated in O(1) per sample
+typedef struct _touch_trace_t {
+  touch_point_t first;
+  touch_point_t last;
+  int           contact;       // kernel tracking id, unique per contact
+  int           count;
+  int           min_x, min_y;  // bounding box
+  int           max_x, max_y;
+  int           path_len;      // summed manhattan distance
+  long long     first_ms;      // event timestamps
+  long long     last_ms;
+  int           vx, vy;        // smoothed velocity, px/s
+  bool          held;          // TOUCH_HOLD already sent
+} touch_trace_t;
+
+typedef struct _touch_track_t {
+  touch_trace_t *traces;
+  int           num;
+  int           active;       // traces with count > 0
+  int           max_active;   // most fingers down at once in this touch
+  bool          gestured;     // a swipe was already sent for this touch
+} touch_track_t;
+
+#define TRACE_EMPTY(tr) ((tr)->count == 0)
+
 typedef map<gesture_t, gesture_cb_t>   gesture_to_cb_t;
 typedef map<touch_event_t, touch_event_cb_t> touch_event_to_cb_t;
 
 static bool reverse_y = false;
 
-touch_track_t touch_tracks(TOUCH_TRACE_NUM);
+touch_track_t touch_tracks;
 
 gesture_to_cb_t     gesture_to_cb;
 touch_cb_t          touch_cb = NULL;
@@ -74,8 +110,71 @@ touch_event_to_cb_t touch_event_to_cb;
 
 char default_info[128];
 
+static gesture_stat_t  gesture_stats[MUG_GESTURE_NUM];
+static long long       gesture_latency_sum[MUG_GESTURE_NUM];
+static long long       gesture_duration_sum[MUG_GESTURE_NUM];
+static pthread_mutex_t gesture_stat_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 #define DEFAULT_INFO default_info
 
+// kernel timestamp to callback latency, LATENCY_BUCKET_US wide buckets,
+// the last one collects everything slower
+#define LATENCY_BUCKET_US 100
+#define LATENCY_BUCKETS   2048
+
+static unsigned int    latency_hist[LATENCY_BUCKETS];
+static touch_stat_t    touch_stat;
+static pthread_mutex_t touch_stat_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// timestamp of the event being parsed, us
+static long long event_us = 0;
+
+static int record_fd = -1;
+
+static void touch_stat_callback(long long stamp)
+{
+  int latency = (int)(now_us() - stamp);
+  int bucket = latency / LATENCY_BUCKET_US;
+
+  if(bucket < 0)
+    bucket = 0;
+  if(bucket >= LATENCY_BUCKETS)
+    bucket = LATENCY_BUCKETS - 1;
+
+  pthread_mutex_lock(&touch_stat_mutex);
+  latency_hist[bucket]++;
+  touch_stat.callbacks++;
+  if(latency > touch_stat.max_latency)
+    touch_stat.max_latency = latency;
+  pthread_mutex_unlock(&touch_stat_mutex);
+}
+
+static void touch_stat_events(int n)
+{
+  pthread_mutex_lock(&touch_stat_mutex);
+  touch_stat.events += n;
+  pthread_mutex_unlock(&touch_stat_mutex);
+}
+
+// upper edge of the bucket holding the pct-th percentile, capped at the
+// max, call with lock held
+static int latency_percentile(int pct)
+{
+  unsigned int rank = ((long long)touch_stat.callbacks * pct + 99) / 100;
+  unsigned int seen = 0;
+
+  if(rank == 0)
+    return 0;
+
+  for(int i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += latency_hist[i];
+    if(seen >= rank)
+      return min((i + 1) * LATENCY_BUCKET_US, touch_stat.max_latency);
+  }
+
+  return touch_stat.max_latency;
+}
+
 //#define debug_printf printf
 #define debug_printf(...) 
 
@@ -88,168 +187,109 @@ static uv_loop_t   *touch_loop = NULL;
 
 // async handler
 uv_async_t  async_touch;
-uv_async_t  async_gesture;
-uv_async_t  async_touch_event;
  
 #define LOCK_ uv_mutex_lock(&uv_mutex)
 #define UNLOCK_  uv_mutex_unlock(&uv_mutex)
 
-typedef struct uv_touch_ {
-  int        x, y;
-  int        id;
-  touch_cb_t cb;
-} uv_touch_t;
+// callbacks are queued as POD records on a single-producer/single-consumer
+// ring: the reader side pushes, the async handler drains
+#define TOUCH_RING_SIZE 256   // power of 2
+
+typedef enum {
+  RECORD_TOUCH,
+  RECORD_TOUCH_EVENT,
+  RECORD_GESTURE
+} touch_record_type_t;
+
+typedef struct _touch_record_t {
+  touch_record_type_t type;
+  int                 event;  // touch_event_t or gesture_t
+  int                 x, y;
+  int                 id;
+  char               *info;
+  long long           stamp;  // event timestamp, us
+  union {
+    touch_cb_t        touch;
+    touch_event_cb_t  touch_event;
+    gesture_cb_t      gesture;
+  } cb;
+} touch_record_t;
+
+static spsc_ring_t<touch_record_t, TOUCH_RING_SIZE> touch_ring;
 
-typedef list<uv_touch_t*> touch_list_t;
-touch_list_t *touch_list;
-
-#if 0
 void uv_touch_cb(uv_async_t *handle, int status) 
 {
-  static int i = 0;
+  touch_record_t r;
 
-  uv_touch_t *touch = (uv_touch_t*)(handle->data);
-  debug_printf("%s: %d (%d x %d, %d)\n", __FUNCTION__, i++, touch->x, touch->y, touch->id);
-  fflush(0);
-  touch->cb(touch->x, touch->y, touch->id);
+  while(ring_pop(&touch_ring, &r, 1) > 0) {
+    touch_stat_callback(r.stamp);
 
-  free(touch);
-}
-#else
-void uv_touch_cb(uv_async_t *handle, int status) 
-{
-  touch_list_t *pending_touchs;
-  pending_touchs = (touch_list_t*)(handle->data);
-  uv_touch_t *touch;
-  for(touch_list_t::iterator itr = pending_touchs->begin();
-      itr != pending_touchs->end();
-      itr++) {
-    touch = *itr;
-    debug_printf("%s: %d (%d x %d, %d)\n", __FUNCTION__, i++, touch->x, touch->y, touch->id);  
-    touch->cb(touch->x, touch->y, touch->id);    
-    free(touch);
+    switch(r.type) {
+    case RECORD_TOUCH:
+      debug_printf("%s: touch (%d x %d, %d)\n", __FUNCTION__, r.x, r.y, r.id);
+      r.cb.touch(r.x, r.y, r.id);
+      break;
+    case RECORD_TOUCH_EVENT:
+      debug_printf("%s: event %d @ (%d, %d, %d)\n", __FUNCTION__, r.event, r.x, r.y, r.id);
+      r.cb.touch_event((touch_event_t)r.event, r.x, r.y, r.id);
+      break;
+    case RECORD_GESTURE:
+      debug_printf("%s: gesture %d\n", __FUNCTION__, r.event);
+      r.cb.gesture((gesture_t)r.event, r.info);
+      break;
+    }
   }
-  
-  pending_touchs->clear();
 }
 
-#endif
 void involk_touch_cb(touch_cb_t cb, int x, int y, int id)
 {
-  static int i = 0;
-  MUG_ASSERT(cb, "no callback for touch\n");
-
-  uv_touch_t *touch = (uv_touch_t*)malloc(sizeof(uv_touch_t));
-  touch->cb = cb;
-  touch->x = x;
-  touch->y = y;
-  touch->id = id;
-  touch_list->push_back(touch);
-  async_touch.data = (void*)touch_list;
-
-  debug_printf("%s: %d (%d x %d, %d)\n", __FUNCTION__, i++, touch->x, touch->y, touch->id);
-
-  uv_async_send(&async_touch);  
-
-}
-
-typedef struct uv_touch_event_ {
-  touch_event_t event;
-  int        x, y;
-  int        id;
-  touch_event_cb_t cb;
-} uv_touch_event_t;
-
-typedef list<uv_touch_event_t*> touch_event_list_t;
-touch_event_list_t *touch_event_list;
+  touch_record_t r;
 
-void uv_touch_event_cb(uv_async_t *handle, int status)
-{
-  touch_event_list_t *pending = (touch_event_list_t*)(handle->data);
-  uv_touch_event_t *event;
+  MUG_ASSERT(cb, "no callback for touch\n");
 
-  for(touch_event_list_t::iterator itr = pending->begin();
-      itr != pending->end();
-      itr++) {
-      
-    event = *itr;
-    debug_printf("%s event %d @ (%d, %d, %d)\n", __FUNCTION__, event->event, event->x, event->y, event->id);
-    event->cb(event->event, event->x, event->y, event->id);
-    free(event);
-  }
+  r.type = RECORD_TOUCH;
+  r.stamp = event_us;
+  r.cb.touch = cb;
+  r.x = x;
+  r.y = y;
+  r.id = id;
 
-  pending->clear();
+  if(ring_push(&touch_ring, &r))
+    uv_async_send(&async_touch);
 }
 
 void involk_touch_event_cb(touch_event_cb_t cb, touch_event_t event, int x, int y, int id)
 {
-  uv_touch_event_t *touch_event = (uv_touch_event_t*)malloc(sizeof(uv_touch_event_t));
+  touch_record_t r;
 
   MUG_ASSERT(cb, "no callback for touch event\n");
 
-  touch_event->cb = cb;
-  touch_event->event = event;
-  touch_event->x = x;
-  touch_event->y = y;
-  touch_event->id = id;
-
-  touch_event_list->push_back(touch_event);
-  async_touch_event.data = (void*)touch_event_list;
-
-  debug_printf("%s event: %d @ (%d, %d, %d)\n", __FUNCTION__, event, x, y, id);
+  r.type = RECORD_TOUCH_EVENT;
+  r.stamp = event_us;
+  r.cb.touch_event = cb;
+  r.event = event;
+  r.x = x;
+  r.y = y;
+  r.id = id;
 
-  uv_async_send(&async_touch_event);
-  
-#ifdef USE_LIBUV
-  //dirty work around
-  //usleep(1 * 1000);
-#endif
+  if(ring_push(&touch_ring, &r))
+    uv_async_send(&async_touch);
 } 
 
-typedef struct uv_gesture_ {
-  gesture_t     gesture;
-  char         *info;
-  gesture_cb_t  cb;
-} uv_gesture_t;
-
-typedef list<uv_gesture_t*> gesture_list_t;
-gesture_list_t *gesture_list;
-
-void uv_gesture_cb(uv_async_t *handle, int status)
-{
-  gesture_list_t *pending = (gesture_list_t*)(handle->data);
-
-  uv_gesture_t *gesture;
-
-  for(gesture_list_t::iterator itr =  pending->begin();
-      itr != pending->end();
-      itr++) {
-    gesture = *itr;       
-    debug_printf("%s: %d\n", __FUNCTION__, gesture);
-    gesture->cb(gesture->gesture, gesture->info);
-    free(gesture);
-  }
-
-  pending->clear();
-}
-
 void involk_gesture_cb(gesture_cb_t cb, gesture_t g, char* info)
 {
-  uv_gesture_t *gesture = (uv_gesture_t*)malloc(sizeof(uv_gesture_t));
+  touch_record_t r;
 
   MUG_ASSERT(cb, "no callback for gesture\n");
 
-  gesture->gesture = g;
-  gesture->info = info;
-  gesture->cb = cb;
-
-  gesture_list->push_back(gesture);
-  
-  async_gesture.data = (void*)gesture_list;
-
-  debug_printf("%s\n", __FUNCTION__);
+  r.type = RECORD_GESTURE;
+  r.stamp = event_us;
+  r.cb.gesture = cb;
+  r.event = g;
+  r.info = info;
 
-  uv_async_send(&async_gesture);
+  if(ring_push(&touch_ring, &r))
+    uv_async_send(&async_touch);
 }
 
 #define INVOLK_TOUCH_CB(cb, x, y, id) involk_touch_cb(cb, x, y, id)
@@ -258,9 +298,9 @@ void involk_gesture_cb(gesture_cb_t cb, gesture_t g, char* info)
 #else
 #define LOCK_
 #define UNLOCK_
-#define INVOLK_TOUCH_CB(cb, x, y, id) cb(x, y, id)
-#define INVOLK_GESTURE_CB(cb, g, info) cb(g, info)
-#define INVOLK_TOUCH_EVENT_CB(cb, e, x, y, id) cb(e, x, y, id)
+#define INVOLK_TOUCH_CB(cb, x, y, id) do { touch_stat_callback(event_us); cb(x, y, id); } while(0)
+#define INVOLK_GESTURE_CB(cb, g, info) do { touch_stat_callback(event_us); cb(g, info); } while(0)
+#define INVOLK_TOUCH_EVENT_CB(cb, e, x, y, id) do { touch_stat_callback(event_us); cb(e, x, y, id); } while(0)
 #endif
 
 void dump_point(touch_point_t *p)
@@ -270,22 +310,19 @@ void dump_point(touch_point_t *p)
 
 void dump_trace(touch_trace_t *p)
 {
-  touch_point_t *pt;
-
-  for(touch_trace_t::iterator itr = p->begin(); itr != p->end(); itr++) {
-    pt = &(*itr);
-    dump_point(pt);
-    debug_printf("\n");
-  }
+  dump_point(&p->first);
+  debug_printf(" -> ");
+  dump_point(&p->last);
+  debug_printf(" n %d len %d v (%d, %d)\n", p->count, p->path_len, p->vx, p->vy);
 }
 
 void dump_track(touch_track_t *p)
 {
-  touch_trace_t *tr;
-
-  for(int i = 0; i < TOUCH_TRACE_NUM; i++) {
+  for(int i = 0; i < p->num; i++) {
+    if(TRACE_EMPTY(&p->traces[i]))
+      continue;
     debug_printf("trace %d\n", i);
-    dump_trace(p->at(0));
+    dump_trace(&p->traces[i]);
   }
 }
 
@@ -298,24 +335,90 @@ void reset_point(touch_point_t *p)
   p->tracking_id = MT_INVALID_VALUE;
 }
 
-void init_tracks()
+void clear_trace(touch_trace_t *tr)
+{
+  memset(tr, 0, sizeof(touch_trace_t));
+}
+
+void clear_tracks() 
+{
+  memset(touch_tracks.traces, 0, touch_tracks.num * sizeof(touch_trace_t));
+  touch_tracks.active = 0;
+  touch_tracks.max_active = 0;
+  touch_tracks.gestured = false;
+}
+
+void init_tracks(int num)
 {
   strcpy(default_info, "no info");
-  for(int i = 0; i < TOUCH_TRACE_NUM; i++) {
-    touch_tracks[i] = new touch_trace_t();
+
+  if(touch_tracks.traces == NULL) {
+    touch_tracks.num = num;
+    touch_tracks.traces = new touch_trace_t[num];
   }
-#ifdef USE_LIBUV
-  touch_list = new touch_list_t();
-  touch_event_list = new touch_event_list_t();
-  gesture_list = new gesture_list_t();
-#endif
+
+  clear_tracks();
 }
 
-void clear_tracks() 
+// trace of the contact, or a free one; NULL if all are in use
+touch_trace_t* find_trace(touch_track_t *tk, int contact)
+{
+  touch_trace_t *free_tr = NULL;
+
+  for(int i = 0; i < tk->num; i++) {
+    touch_trace_t *tr = &tk->traces[i];
+    if(TRACE_EMPTY(tr)) {
+      if(free_tr == NULL)
+        free_tr = tr;
+    } else if(tr->contact == contact) {
+      return tr;
+    }
+  }
+
+  return free_tr;
+}
+
+// the n-th non-empty trace
+touch_trace_t* nth_trace(touch_track_t *tk, int n)
 {
-  for(int i = 0; i <TOUCH_TRACE_NUM; i++) {
-    touch_tracks[i]->clear();
+  for(int i = 0; i < tk->num; i++) {
+    touch_trace_t *tr = &tk->traces[i];
+    if(!TRACE_EMPTY(tr) && n-- == 0)
+      return tr;
+  }
+
+  return NULL;
+}
+
+void trace_add(touch_trace_t *tr, touch_point_t *p, long long ms)
+{
+  if(TRACE_EMPTY(tr)) {
+    tr->first = *p;
+    tr->min_x = tr->max_x = p->x;
+    tr->min_y = tr->max_y = p->y;
+    tr->first_ms = ms;
+  } else {
+    int dx = p->x - tr->last.x;
+    int dy = p->y - tr->last.y;
+    long long dt = ms - tr->last_ms;
+
+    tr->path_len += abs(dx) + abs(dy);
+
+    if(p->x < tr->min_x) tr->min_x = p->x;
+    if(p->x > tr->max_x) tr->max_x = p->x;
+    if(p->y < tr->min_y) tr->min_y = p->y;
+    if(p->y > tr->max_y) tr->max_y = p->y;
+
+    // samples of one report share a timestamp, keep the last velocity
+    if(dt > 0) {
+      tr->vx = (tr->vx + dx * 1000 / dt) / 2;
+      tr->vy = (tr->vy + dy * 1000 / dt) / 2;
+    }
   }
+
+  tr->last = *p;
+  tr->last_ms = ms;
+  tr->count++;
 }
 
 bool validate_point(touch_point_t *p)
@@ -348,7 +451,10 @@ void involk_touch_down(touch_point_t *p)
     INVOLK_TOUCH_EVENT_CB(cb, TOUCH_DOWN, SCALE_X(p->x), SCALE_Y(p->y), p->tracking_id);
 
 }
-void add_point(touch_point_t *p)
+void update_hold(touch_trace_t *tr);
+void update_gesture(touch_track_t *tk);
+
+void add_point(touch_point_t *p, int contact, long long ms)
 {
   if(!(p && validate_point(p))) {
 #ifdef DEBUG
@@ -359,18 +465,25 @@ void add_point(touch_point_t *p)
     return;
   }
 
-  touch_point_t last;
-  touch_trace_t *trace = touch_tracks[p->tracking_id];
+  touch_trace_t *trace = find_trace(&touch_tracks, contact);
   bool run_cb = false;
 
-  if(trace->empty()) {
+  if(trace == NULL) {
+    debug_printf("no free trace for %d\n", p->tracking_id);
+    return;
+  }
+
+  if(TRACE_EMPTY(trace)) {
+    trace->contact = contact;
     involk_touch_down(p);
+    touch_tracks.active++;
+    if(touch_tracks.active > touch_tracks.max_active)
+      touch_tracks.max_active = touch_tracks.active;
   }
 
   if(touch_cb) {
-    if(!trace->empty()) {
-      last = trace->back();
-      if(last.x != p->x || last.y != p->y)
+    if(!TRACE_EMPTY(trace)) {
+      if(trace->last.x != p->x || trace->last.y != p->y)
         run_cb = true;
     } else {
       run_cb = true;
@@ -380,11 +493,12 @@ void add_point(touch_point_t *p)
       INVOLK_TOUCH_CB(touch_cb, SCALE_X(p->x), SCALE_Y(p->y), p->tracking_id);
   }
 
-  touch_point_t save = *p;
+  debug_printf("+(%d, %d, %d) %d\n", p->x, p->y, p->tracking_id, trace->count);
+  trace_add(trace, p, ms);
+
+  update_hold(trace);
+  update_gesture(&touch_tracks);
 
-  debug_printf("+(%d, %d, %d) %d\n", p->x, p->y, p->tracking_id, trace->size());
-  trace->push_back(save);
-  
 }
 
 void normalize_point(touch_point_t *point)
@@ -399,10 +513,132 @@ void normalize_point(touch_point_t *point)
     point->y = oldx;
 }
 
+// protocol B: contacts live in slots and only changes are reported,
+// the panel's state is sampled on every SYN_REPORT
+static bool           mt_b = false;
+static touch_point_t *slots = NULL;
+static int           *slot_contacts = NULL; // kernel tracking id in each slot
+static int            slot_num = 0;
+static int            cur_slot = 0;
+
+// a touch is going on
+static bool is_reading = false;
+
+void mug_finish_touch_data();
+
+void init_slots(int fd)
+{
+  unsigned long absbits[NBITS(ABS_MAX)];
+  struct input_absinfo abs;
+
+  memset(absbits, 0, sizeof(absbits));
+  slot_num = TOUCH_TRACE_NUM;
+
+  if(ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(absbits)), absbits) >= 0
+     && test_bit(ABS_MT_SLOT, absbits)
+     && ioctl(fd, EVIOCGABS(ABS_MT_SLOT), &abs) == 0) {
+    mt_b = true;
+    cur_slot = abs.value;
+    if(abs.maximum + 1 > slot_num)
+      slot_num = abs.maximum + 1;
+  }
+
+  slots = new touch_point_t[slot_num];
+  slot_contacts = new int[slot_num];
+  for(int i = 0; i < slot_num; i++)
+    reset_point(&slots[i]);
+}
+
+// add a sample for every finger down, false if there is none
+bool report_slots()
+{
+  bool down = false;
+
+  for(int i = 0; i < slot_num; i++) {
+    if(!validate_point(&slots[i]))
+      continue;
+
+    touch_point_t p = slots[i];
+    normalize_point(&p);
+    add_point(&p, slot_contacts[i], event_us / 1000);
+    down = true;
+  }
+
+  return down;
+}
+
+bool slots_down()
+{
+  for(int i = 0; i < slot_num; i++) {
+    if(slots[i].tracking_id != MT_INVALID_VALUE)
+      return true;
+  }
+
+  return false;
+}
+
+void parse_event_b(input_event *event)
+{
+  touch_point_t *p = (cur_slot >= 0 && cur_slot < slot_num) ? &slots[cur_slot] : NULL;
+
+  // the last finger lifted, no need to wait for the idle timeout
+  if(event->type == EV_SYN && event->code == SYN_REPORT) {
+    if(!report_slots())
+      mug_finish_touch_data();
+    return;
+  }
+
+  if(event->type != EV_ABS || p == NULL)
+    return;
+
+  switch(event->code) {
+
+  case ABS_MT_POSITION_X:
+    p->x = event->value;
+    break;
+
+  case ABS_MT_POSITION_Y:
+    p->y = event->value;
+    break;
+
+  case ABS_MT_PRESSURE:
+    p->pressure = event->value;
+    break;
+
+  case ABS_MT_TRACKING_ID:
+    // -1 lifts the contact; report the slot as id so apps see small ids,
+    // but trace the kernel's id, a reused slot is a new finger
+    if(event->value < 0) {
+      reset_point(p);
+    } else {
+      p->tracking_id = cur_slot;
+      slot_contacts[cur_slot] = event->value;
+    }
+    break;
+
+  case ABS_MT_TOUCH_MAJOR:
+    p->touch_major = event->value;
+    break;
+  }
+}
+
 void parse_event(input_event *event)
 {
   static touch_point_t point_save = {MT_INVALID_VALUE};
 
+  event_us = event->time.tv_sec * 1000000LL + event->time.tv_usec;
+
+  if(event->type == EV_ABS && event->code == ABS_MT_SLOT) {
+    mt_b = true;
+    cur_slot = event->value;
+    return;
+  }
+
+  if(mt_b) {
+    parse_event_b(event);
+    return;
+  }
+
   if(event->type == EV_SYN && event->code == SYN_DROPPED) {
 #ifdef DEBUG
     debug_printf("drpped ");
@@ -413,7 +649,7 @@ void parse_event(input_event *event)
 
   if(event->type == EV_SYN && event->code == SYN_MT_REPORT) {
     normalize_point(&point_save);
-    add_point(&point_save);
+    add_point(&point_save, point_save.tracking_id, event_us / 1000);
     reset_point(&point_save);
   };
 
@@ -445,7 +681,7 @@ void parse_event(input_event *event)
 
 bool validate_trace(touch_trace_t *tr)
 {
-  if(tr->size() < TRACE_MIN_NUM) {
+  if(tr->count < TRACE_MIN_NUM) {
     return false;
   }
 
@@ -456,22 +692,24 @@ void validate_track()
 {
   touch_trace_t *tr;
 
-  for(int i = 0; i < TOUCH_TRACE_NUM; i++) {
-    tr = touch_tracks[i];
-    if(!validate_trace(tr)) {
-      debug_printf("abondon tr[%d] size: %d\n", i, tr->size());
-      tr->clear();
+  for(int i = 0; i < touch_tracks.num; i++) {
+    tr = &touch_tracks.traces[i];
+    if(!TRACE_EMPTY(tr) && !validate_trace(tr)) {
+      debug_printf("abondon tr[%d] size: %d\n", i, tr->count);
+      clear_trace(tr);
+      touch_tracks.active--;
     }
   }
 }
 
-gesture_t calc_dir(touch_trace_t *tr)
+// swipe direction once the trace covers 1/div of the panel
+gesture_t calc_dir(touch_trace_t *tr, int div)
 {
   debug_printf("%s ", __FUNCTION__);
   dump_trace(tr);
   touch_point_t *start, *end;
-  start = &(tr->front());
-  end = &(tr->back());
+  start = &tr->first;
+  end = &tr->last;
   
   int x = end->x - start->x;
   int y = end->y - start->y;
@@ -489,8 +727,7 @@ gesture_t calc_dir(touch_trace_t *tr)
 
   if(absx > absy) {
 
-    // make sure swip 1/4 distance    
-    if(absx < TOUCH_WIDTH / 4) return rec;
+    if(absx < TOUCH_WIDTH / div) return rec;
 
     if(x > 0)
       rec = MUG_SWIPE_RIGHT;
@@ -498,7 +735,7 @@ gesture_t calc_dir(touch_trace_t *tr)
       rec = MUG_SWIPE_LEFT;
   } else if(absx < absy){
 
-    if(absy < TOUCH_HEIGHT / 4) return rec;
+    if(absy < TOUCH_HEIGHT / div) return rec;
     if( y > 0)
       rec = MUG_SWIPE_DOWN;
     else
@@ -509,17 +746,31 @@ gesture_t calc_dir(touch_trace_t *tr)
   return rec;
 }
 
+// short swipe that is still moving fast in its direction
+gesture_t calc_fling(touch_trace_t *tr)
+{
+  gesture_t rec = calc_dir(tr, 8);
+
+  switch(rec) {
+  case MUG_SWIPE_LEFT:  return -tr->vx >= FLING_MIN_SPEED ? rec : MUG_NO_GESTURE;
+  case MUG_SWIPE_RIGHT: return  tr->vx >= FLING_MIN_SPEED ? rec : MUG_NO_GESTURE;
+  case MUG_SWIPE_UP:    return -tr->vy >= FLING_MIN_SPEED ? rec : MUG_NO_GESTURE;
+  case MUG_SWIPE_DOWN:  return  tr->vy >= FLING_MIN_SPEED ? rec : MUG_NO_GESTURE;
+  default:              return MUG_NO_GESTURE;
+  }
+}
+
 bool is_hold(touch_trace_t *tr)
 {
   touch_point_t start, end;
-  start = tr->front();
-  end   = tr->back();
+  start = tr->first;
+  end   = tr->last;
 
   start.x = SCALE_X(start.x);
-  start.y = SCALE_X(start.y);
+  start.y = SCALE_Y(start.y);
 
   end.x = SCALE_X(end.x);
-  end.y = SCALE_X(end.y);
+  end.y = SCALE_Y(end.y);
 
   int xdiff = end.x - start.x;
   int ydiff = end.y - start.y;
@@ -529,58 +780,104 @@ bool is_hold(touch_trace_t *tr)
 
 }
 
-bool parse_swipe(gesture_t g, gesture_cb_t cb, touch_track_t *tk)
+// event timestamps are CLOCK_MONOTONIC, see setup_touch_fd; event_us is
+// the sample that completed the gesture
+void record_gesture_stat(gesture_t g, touch_trace_t *tr)
 {
-  touch_trace_t *tr0 = tk->at(0);
-  touch_trace_t *tr1 = tk->at(1);
+  long long now = now_us();
+  int latency = (int)(now - event_us);
+  int duration = (int)(now / 1000 - tr->first_ms);
+  gesture_stat_t *st = &gesture_stats[g];
+
+  pthread_mutex_lock(&gesture_stat_mutex);
+  st->count++;
+  gesture_latency_sum[g] += latency;
+  st->avg_latency = gesture_latency_sum[g] / st->count;
+  if(latency > st->max_latency)
+    st->max_latency = latency;
+  gesture_duration_sum[g] += duration;
+  st->avg_duration = gesture_duration_sum[g] / st->count;
+  if(duration > st->max_duration)
+    st->max_duration = duration;
+  pthread_mutex_unlock(&gesture_stat_mutex);
+}
 
-  if(!tr0->empty()&& !tr1->empty() // both trace 0 and 1 are all set
-     && (g == MUG_GESTURE || MUG_SWIPE_2 <= g && g <= MUG_SWIPE_DOWN_2)) {
-    gesture_t rec0 = calc_dir(tr0);
-    gesture_t rec1 = calc_dir(tr1);
-    
-    if(rec0 != MUG_NO_GESTURE && rec0 == rec1) {
-      gesture_t rec = (gesture_t)(MUG_SWIPE_2 + (rec0 - MUG_SWIPE));
-      if(g == MUG_GESTURE || g == MUG_SWIPE_2 || g == rec) {
-        INVOLK_GESTURE_CB(cb, rec, DEFAULT_INFO);  
-      }
-    }
+// send rec to every callback whose gesture covers it
+void emit_gesture(gesture_t rec, touch_trace_t *tr)
+{
+  gesture_t group = rec >= MUG_SWIPE_2 ? MUG_SWIPE_2 : MUG_SWIPE;
+
+  for(gesture_to_cb_t::iterator itr = gesture_to_cb.begin();
+      itr != gesture_to_cb.end();
+      itr++) {
+    gesture_t g = (*itr).first;
+    if(g == MUG_GESTURE || g == group || g == rec)
+      INVOLK_GESTURE_CB((*itr).second, rec, DEFAULT_INFO);
   }
 
-  if(!tr0->empty() && tr1->empty() //only trace 0 is set 
-     && (g == MUG_GESTURE || MUG_SWIPE <= g && g <= MUG_SWIPE_DOWN)) {
-    gesture_t rec = calc_dir(tr0);
+  record_gesture_stat(rec, tr);
+}
 
-    if(rec != MUG_NO_GESTURE) {
-      if(g == MUG_GESTURE || g == MUG_SWIPE || g == rec) {
-        INVOLK_GESTURE_CB(cb, rec, DEFAULT_INFO);      
-      }
-    }
-  }
- 
-  return true;
+gesture_t detect_swipe(touch_trace_t *tr)
+{
+  if(!validate_trace(tr))
+    return MUG_NO_GESTURE;
+
+  gesture_t rec = calc_dir(tr, 4);
+
+  if(rec == MUG_NO_GESTURE)
+    rec = calc_fling(tr);
+
+  return rec;
 }
 
-void parse_gesture(gesture_t g, gesture_cb_t cb, touch_track_t *tk) 
+// called on every sample, sends at most one swipe per touch
+void update_gesture(touch_track_t *tk)
 {
+  gesture_t rec = MUG_NO_GESTURE;
+  touch_trace_t *tr0 = nth_trace(tk, 0);
+
+  if(tk->gestured || gesture_to_cb.empty())
+    return;
+
+  // a touch that ever had another finger down is not a one finger swipe
+  if(tk->max_active == 1) {
+    rec = detect_swipe(tr0);
+  } else if(tk->max_active == 2 && tk->active == 2) {
+    gesture_t rec0 = detect_swipe(tr0);
+    gesture_t rec1 = detect_swipe(nth_trace(tk, 1));
+
+    if(rec0 != MUG_NO_GESTURE && rec0 == rec1)
+      rec = (gesture_t)(MUG_SWIPE_2 + (rec0 - MUG_SWIPE));
+  }
 
-  if(g == MUG_GESTURE || MUG_SWIPE <= g && g <= MUG_SWIPE_DOWN_2)
-    parse_swipe(g, cb, tk);
+  if(rec != MUG_NO_GESTURE) {
+    tk->gestured = true;
+    emit_gesture(rec, tr0);
+  }
 }
 
-void parse_all_gesture()
+// TOUCH_HOLD as soon as a still finger has been down for HOLD_MIN_MS
+void update_hold(touch_trace_t *tr)
 {
-  for(gesture_to_cb_t::iterator itr = gesture_to_cb.begin();
-      itr != gesture_to_cb.end();
+  touch_point_t *last = &tr->last;
+
+  if(tr->held || tr->last_ms - tr->first_ms < HOLD_MIN_MS || !is_hold(tr))
+    return;
+
+  tr->held = true;
+
+  for(touch_event_to_cb_t::iterator itr = touch_event_to_cb.begin();
+      itr != touch_event_to_cb.end();
       itr++) {
-    parse_gesture((*itr).first, (*itr).second, &touch_tracks);
+    if((*itr).first == TOUCH_EVENT_ALL || (*itr).first == TOUCH_HOLD)
+      INVOLK_TOUCH_EVENT_CB((*itr).second, TOUCH_HOLD, SCALE_X(last->x), SCALE_Y(last->y), last->tracking_id);
   }
 }
 
 void parse_touch_event(touch_event_t event, touch_trace_t *tr)
 {
-  touch_point_t back = tr->back();
-  touch_point_t *last = &back;
+  touch_point_t *last = &tr->last;
 
   touch_event_cb_t cb = get_touch_event_cb(event);
 
@@ -590,22 +887,18 @@ void parse_touch_event(touch_event_t event, touch_trace_t *tr)
   }
 
   if(event == TOUCH_EVENT_ALL || event == TOUCH_CLICK) {
-    if(is_hold(tr) && tr->size() < HOLD_MIN_NUM)
+    if(is_hold(tr) && !tr->held)
       INVOLK_TOUCH_EVENT_CB(cb, TOUCH_CLICK, SCALE_X(last->x), SCALE_Y(last->y), last->tracking_id);
   }
 
-  if(event == TOUCH_EVENT_ALL || event == TOUCH_HOLD) {
-    if(is_hold(tr) && tr->size() > HOLD_MIN_NUM)
-      INVOLK_TOUCH_EVENT_CB(cb, TOUCH_HOLD, SCALE_X(last->x), SCALE_Y(last->y), last->tracking_id);
-  }
-
+  // TOUCH_HOLD was sent by update_hold while the finger was down
 }
 
 void parse_all_touch_event()
 {
-  for(int i = 0; i < TOUCH_TRACE_NUM; i++) {
-    touch_trace_t *tr = touch_tracks[i];
-    if(tr->empty())
+  for(int i = 0; i < touch_tracks.num; i++) {
+    touch_trace_t *tr = &touch_tracks.traces[i];
+    if(TRACE_EMPTY(tr))
       continue;
     for(touch_event_to_cb_t::iterator itr = touch_event_to_cb.begin();
         itr != touch_event_to_cb.end();
@@ -616,10 +909,17 @@ void parse_all_touch_event()
 }
 
 #ifdef USE_LIBUV
+uv_poll_t  touch_poll;
+uv_poll_t  hotplug_poll;
 uv_timer_t touch_timer;
-void uv_touch_timer(uv_timer_t *timer, int status);
+void uv_touch_poll(uv_poll_t *req, int status, int events);
+void uv_touch_hotplug(uv_poll_t *req, int status, int events);
 #endif
 
+static struct input_id touch_id;
+static bool            touch_lost = false;
+static int             inotify_fd = -1;
+
 static bool is_touch_device(int fd)
 {
   int i, j;
@@ -658,11 +958,81 @@ static int is_event_device(const struct dirent *dir) {
   return strncmp(EVENT_DEV_NAME, dir->d_name, 5) == 0;
 }
 
+static bool same_device(struct input_id *a, struct input_id *b)
+{
+  return a->bustype == b->bustype
+    && a->vendor == b->vendor
+    && a->product == b->product;
+}
+
+// /tmp is world writable: write a fresh file and rename it over the
+// cache, so a planted symlink is replaced rather than followed
+static void write_dev_cache(const char *path, struct input_id *id)
+{
+  char tmp[] = TOUCH_DEV_CACHE ".XXXXXX";
+
+  int fd = mkstemp(tmp);
+  if(fd < 0)
+    return;
+
+  fchmod(fd, 0644);
+
+  FILE *fp = fdopen(fd, "w");
+  if(fp == NULL) {
+    close(fd);
+    unlink(tmp);
+    return;
+  }
+
+  fprintf(fp, "%s %hx %hx %hx\n", path, id->bustype, id->vendor, id->product);
+
+  if(fclose(fp) != 0 || rename(tmp, TOUCH_DEV_CACHE) != 0)
+    unlink(tmp);
+}
+
+// the cached node, if it is still the same panel
+static handle_t open_cached_device(void)
+{
+  char path[64];
+  struct input_id cached, id;
+
+  int cache = open(TOUCH_DEV_CACHE, O_RDONLY | O_NOFOLLOW);
+  if(cache < 0)
+    return (handle_t)NULL;
+
+  FILE *fp = fdopen(cache, "r");
+  if(fp == NULL) {
+    close(cache);
+    return (handle_t)NULL;
+  }
+
+  int n = fscanf(fp, "%63s %hx %hx %hx", path, &cached.bustype, &cached.vendor, &cached.product);
+  fclose(fp);
+
+  // only ever points at an input node
+  if(n != 4 || strncmp(path, DEV_INPUT_EVENT "/", strlen(DEV_INPUT_EVENT "/")) != 0)
+    return (handle_t)NULL;
+
+  int fd = open(path, O_RDONLY);
+  if(fd < 0)
+    return (handle_t)NULL;
+
+  if(ioctl(fd, EVIOCGID, &id) < 0 || !same_device(&id, &cached)) {
+    close(fd);
+    return (handle_t)NULL;
+  }
+
+  TP_PRINT("%s: cached touch panel\n", path);
+  touch_id = id;
+
+  return (handle_t)fd;
+}
+
 static handle_t scan_devices(void)
 {
   struct dirent **namelist;
-  int i, ndev, devnum;
-  char *filename;
+  int i, ndev;
+  handle_t handle = (handle_t)NULL;
 
   ndev = scandir(DEV_INPUT_EVENT, &namelist, is_event_device, alphasort);
   if (ndev <= 0)
@@ -677,6 +1047,10 @@ static handle_t scan_devices(void)
 
     snprintf(fname, sizeof(fname),
        "%s/%s", DEV_INPUT_EVENT, namelist[i]->d_name);
+    free(namelist[i]);
+
+    if(handle)
+      continue;
 
     fd = open(fname, O_RDONLY);
     if (fd < 0)
@@ -684,57 +1058,163 @@ static handle_t scan_devices(void)
     ioctl(fd, EVIOCGNAME(sizeof(name)), name);
 
     TP_PRINT("%s:    %s\n", fname, name);
-    if(is_touch_device(fd)) {
+    if(is_touch_device(fd) && ioctl(fd, EVIOCGID, &touch_id) == 0) {
       TP_PRINT("--> is touch panel\n");
-      asprintf(&filename, "%s/%s", DEV_INPUT_EVENT, namelist[i]->d_name);
-      return (handle_t)fd;
+      write_dev_cache(fname, &touch_id);
+      handle = (handle_t)fd;
     } else {
       close(fd);
     }
-    free(namelist[i]);
   }
 
-  return (handle_t)NULL;
+  free(namelist);
+
+  return handle;
+}
+
+// notice panels appearing in /dev/input, udev may only make the node
+// readable after creating it
+static void watch_devices(void)
+{
+  inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if(inotify_fd < 0)
+    return;
+
+  if(inotify_add_watch(inotify_fd, DEV_INPUT_EVENT, IN_CREATE | IN_ATTRIB) < 0) {
+    close(inotify_fd);
+    inotify_fd = -1;
+  }
 }
 
+// non-blocking reads, event timestamps from the monotonic clock
+static void setup_touch_fd(int fd)
+{
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+#ifdef EVIOCSCLOCKID
+  int clk = CLOCK_MONOTONIC;
+  ioctl(fd, EVIOCSCLOCKID, &clk);
+#endif
+}
 
 handle_t mug_touch_init() 
 {
-  reverse_y = mug_query_config_int(CONFIG_REVERSE_Y);
 #if 0  
   handle_t handle = mug_init(DEVICE_TP);
 #else
-  handle_t handle = scan_devices();
+  handle_t handle = open_cached_device();
+  if(!handle)
+    handle = scan_devices();
 #endif
 
   MUG_ASSERT(handle, "can not init touch\n");
 
-  init_tracks();
+  watch_devices();
+
+  return mug_touch_init_fd((int)handle);
+}
+
+handle_t mug_touch_init_fd(int fd)
+{
+  handle_t handle = (handle_t)fd;
+
+  reverse_y = mug_query_config_int(CONFIG_REVERSE_Y);
+
+  setup_touch_fd(fd);
+  init_slots(fd);
+  init_tracks(slot_num);
   
 #ifdef USE_LIBUV
   //_mutex_init(&uv_mutex);
   
   touch_loop = uv_default_loop();
   
-  uv_async_init(touch_loop, &async_touch,   uv_touch_cb);
-  uv_async_init(touch_loop, &async_gesture, uv_gesture_cb);
-  uv_async_init(touch_loop, &async_touch_event, uv_touch_event_cb);
-  
-#if 0
-  uv_work_t req;
-  req.data = (void*)handle;
+  uv_async_init(touch_loop, &async_touch, uv_touch_cb);
   
-  uv_queue_work(touch_loop, &req, uv_touch_loop, NULL);
-#else
   touch_timer.data = (void*)handle;
   uv_timer_init(touch_loop, &touch_timer);
-  uv_timer_start(&touch_timer, uv_touch_timer, 0 ,TOUCH_IDLE_TIME);
-#endif
+
+  touch_poll.data = (void*)handle;
+  uv_poll_init(touch_loop, &touch_poll, (int)handle);
+  uv_poll_start(&touch_poll, UV_READABLE, uv_touch_poll);
+
+  if(inotify_fd >= 0) {
+    hotplug_poll.data = (void*)handle;
+    uv_poll_init(touch_loop, &hotplug_poll, inotify_fd);
+    uv_poll_start(&hotplug_poll, UV_READABLE, uv_touch_hotplug);
+  }
 #endif
 
   return handle;
 }
 
+unsigned int mug_touch_dropped(handle_t handle)
+{
+#ifdef USE_LIBUV
+  return ring_overflow(&touch_ring);
+#else
+  return 0;
+#endif
+}
+
+void mug_gesture_get_stat(handle_t handle, gesture_t g, gesture_stat_t *stat)
+{
+  MUG_ASSERT(0 <= g && g < MUG_GESTURE_NUM, "invalid gesture %d\n", g);
+
+  pthread_mutex_lock(&gesture_stat_mutex);
+  *stat = gesture_stats[g];
+  pthread_mutex_unlock(&gesture_stat_mutex);
+}
+
+void mug_touch_get_stat(handle_t handle, touch_stat_t *stat)
+{
+  pthread_mutex_lock(&touch_stat_mutex);
+  *stat = touch_stat;
+  stat->p50_latency = latency_percentile(50);
+  stat->p99_latency = latency_percentile(99);
+  pthread_mutex_unlock(&touch_stat_mutex);
+}
+
+void mug_touch_reset_stat(handle_t handle)
+{
+  pthread_mutex_lock(&touch_stat_mutex);
+  memset(&touch_stat, 0, sizeof(touch_stat));
+  memset(latency_hist, 0, sizeof(latency_hist));
+  pthread_mutex_unlock(&touch_stat_mutex);
+}
+
+int mug_touch_record(handle_t handle, const char *path)
+{
+  touch_rec_header_t header;
+
+  if(record_fd >= 0) {
+    close(record_fd);
+    record_fd = -1;
+  }
+
+  if(path == NULL)
+    return 0;
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0) {
+    printf("can not open touch record: %s\n", path);
+    return -1;
+  }
+
+  header.magic = TOUCH_REC_MAGIC;
+  header.version = TOUCH_REC_VERSION;
+  header.event_size = sizeof(struct input_event);
+
+  if(write(fd, &header, sizeof(header)) != sizeof(header)) {
+    close(fd);
+    return -1;
+  }
+
+  record_fd = fd;
+
+  return 0;
+}
+
 void mug_touch_on(handle_t handle, touch_cb_t cb) 
 {
   touch_cb = cb;
@@ -750,80 +1230,145 @@ void mug_gesture_on(handle_t handle, gesture_t g, gesture_cb_t cb)
   gesture_to_cb[g] = cb;
 }
 
+// the panel went away, e.g. on a driver reset; drop the touch in progress
+static void touch_device_lost()
+{
+  TP_PRINT("touch panel lost\n");
+  touch_lost = true;
+
+  for(int i = 0; i < slot_num; i++)
+    reset_point(&slots[i]);
+
+  mug_finish_touch_data();
+}
+
+// look for the lost panel among new nodes and put it back on the old fd,
+// returns true if it is back
+static bool reattach_touch(handle_t handle)
+{
+  char buf[sizeof(struct inotify_event) + NAME_MAX + 1]
+    __attribute__((aligned(__alignof__(struct inotify_event))));
+  bool found = false;
+  ssize_t len;
+
+  while((len = read(inotify_fd, buf, sizeof(buf))) > 0) {
+    for(char *p = buf; p < buf + len; p += sizeof(struct inotify_event) + ((struct inotify_event*)p)->len) {
+      struct inotify_event *ev = (struct inotify_event*)p;
+      char fname[64];
+      struct input_id id;
+
+      if(found || !touch_lost || ev->len == 0 || strncmp(EVENT_DEV_NAME, ev->name, 5) != 0)
+        continue;
+
+      snprintf(fname, sizeof(fname), "%s/%s", DEV_INPUT_EVENT, ev->name);
+
+      int fd = open(fname, O_RDONLY);
+      if(fd < 0)
+        continue;
+
+      if(ioctl(fd, EVIOCGID, &id) == 0 && same_device(&id, &touch_id)
+         && dup2(fd, (int)handle) >= 0) {
+        TP_PRINT("%s: touch panel is back\n", fname);
+        setup_touch_fd((int)handle);
+        write_dev_cache(fname, &touch_id);
+        touch_lost = false;
+        found = true;
+      }
+
+      close(fd);
+    }
+  }
+
+  return found;
+}
+
+// parse all pending events, returns false if there was nothing to read
 bool mug_read_touch_data(handle_t handle)
 {
   struct input_event events[TOUCH_READ_NUM];
-  static bool is_reading = false;
-
-#ifdef USE_IOHUB
-  mug_error_t err;
-  err = iohub_send_command(handle, 
-                           IOHUB_CMD_TOUCH_PANEL, 
-                           (char*)events,
-                           sizeof(events));
-#else
-  mug_error_t err;
-  err = dev_send_command(handle, 
-                         IOHUB_CMD_TOUCH_PANEL, 
-                         (char*)events,
-                         sizeof(events));
-#endif
+  bool got = false;
+  ssize_t len;
 
-  if(err) {
-    if(is_reading) {
-      validate_track();
-      parse_all_touch_event();
-      parse_all_gesture();
-      clear_tracks();
-    }   
-    is_reading = false;
-    return false;
-  } else {
+  do {
+    len = read((int)handle, events, sizeof(events));
+    if(len <= 0)
+      break;
+
+    got = true;
     is_reading = true;
-    for(int i = 0; i < TOUCH_READ_NUM; i++) {
+    touch_stat_events(len / sizeof(input_event));
+
+    if(record_fd >= 0 && write(record_fd, events, len) != len) {
+      close(record_fd);
+      record_fd = -1;
+    }
+
+    for(int i = 0; i < len / sizeof(input_event); i++) {
       parse_event(&events[i]);
-    } 
-  }
+    }
+  } while(len == sizeof(events));
 
-  return true;
+  if(len < 0 && errno == ENODEV)
+    touch_device_lost();
 
+  return got;
 }
 
+// no events for TOUCH_IDLE_TIMEOUT, the touch is over
+void mug_finish_touch_data()
+{
+  // a still finger sends nothing under protocol B, sample it instead
+  if(mt_b && slots_down()) {
+    event_us = now_us();
+    report_slots();
+    return;
+  }
 
+  if(is_reading) {
+    validate_track();
+    parse_all_touch_event();
+    clear_tracks();
+  }   
+  is_reading = false;
+}
 
 #ifdef USE_LIBUV
 
+void uv_touch_idle(uv_timer_t *timer, int status)
+{
+  mug_finish_touch_data();
 
-void mug_touch_loop(handle_t handle)
+  if(is_reading)
+    uv_timer_start(&touch_timer, uv_touch_idle, TOUCH_IDLE_TIMEOUT, 0);
+}
+
+void uv_touch_poll(uv_poll_t *req, int status, int events)
 {
-#if 0
-  while(1) {
-    if(!mug_read_touch_data(handle))
-      break;
-    uv_timer_stop(&touch_timer);
+  handle_t handle = (handle_t)(req->data);
+
+  // a removed panel polls as POLLHUP|POLLERR, libuv has stopped the watcher
+  // by now and only uv_touch_hotplug can bring it back
+  if(status < 0) {
+    if(!touch_lost)
+      touch_device_lost();
+    return;
   }
 
-  uv_timer_again(&touch_timer);  
-#else
   if(mug_read_touch_data(handle)) {
-    uv_timer_set_repeat(&touch_timer, TOUCH_BUSY_TIME);
-  } else {
-    uv_timer_set_repeat(&touch_timer, TOUCH_IDLE_TIME);
+    uv_timer_start(&touch_timer, uv_touch_idle, TOUCH_IDLE_TIMEOUT, 0);
   }
-  
-#endif
+
+  // the dead fd stays readable, wait for uv_touch_hotplug instead
+  if(touch_lost)
+    uv_poll_stop(&touch_poll);
 }
 
-void uv_touch_loop(uv_work_t *req)
+void uv_touch_hotplug(uv_poll_t *req, int status, int events)
 {
   handle_t handle = (handle_t)(req->data);
-  mug_touch_loop(handle);  
-}
 
-void uv_touch_timer(uv_timer_t *timer, int status)
-{
-  handle_t handle = (handle_t)(timer->data);
-  mug_touch_loop(handle);
+  if(status == 0 && reattach_touch(handle))
+    uv_poll_start(&touch_poll, UV_READABLE, uv_touch_poll);
 }
 
 void mug_run_touch_thread(handle_t handle)
@@ -838,22 +1383,39 @@ void mug_wait_for_touch_thread(handle_t handle)
   MUG_ASSERT(false, "can not run mug_wait_for_touch_thread\n");
 }
 
-void close_cb(uv_handle_t* handle)
-{
-}
-
 void mug_stop_touch_thread(handle_t handle)
 {
-  uv_close((uv_handle_t*)touch_loop, close_cb);
-  //MUG_ASSERT(false, "can not run mug_stop_touch_thread\n");
+  uv_poll_stop(&touch_poll);
+  uv_timer_stop(&touch_timer);
+  if(inotify_fd >= 0)
+    uv_poll_stop(&hotplug_poll);
 }
 
 #else
 
 void mug_touch_loop(handle_t handle)
 {
+  struct pollfd pfd[2];
+  pfd[0].events = POLLIN;
+  pfd[1].fd = inotify_fd;
+  pfd[1].events = POLLIN;
+
   while(1) {
-    mug_read_touch_data(handle);
+    // a lost panel's fd is ignored until it comes back
+    pfd[0].fd = touch_lost ? -1 : (int)handle;
+    pfd[0].revents = pfd[1].revents = 0;
+
+    // only wake up on timeout while a touch is going on
+    int rv = poll(pfd, 2, is_reading ? TOUCH_IDLE_TIMEOUT : -1);
+
+    if(rv > 0) {
+      if(pfd[0].revents)
+        mug_read_touch_data(handle);
+      if(pfd[1].revents)
+        reattach_touch(handle);
+    } else if(rv == 0) {
+      mug_finish_touch_data();
+    }
   }
 }
 
@@ -869,7 +1431,7 @@ pthread_t touch_thread_hdl = (pthread_t)NULL;
 
 void mug_run_touch_thread(handle_t handle)
 {
-  init_tracks();
+  init_tracks(slot_num);
 
   pthread_t hdl;
  
@@ -883,7 +1445,7 @@ void mug_run_touch_thread(handle_t handle)
   //return hdl;
 }
 
-void mug_wait_for_touch_thread()
+void mug_wait_for_touch_thread(handle_t handle)
 {
   void *value_ptr;
 
@@ -892,7 +1454,7 @@ void mug_wait_for_touch_thread()
   pthread_join(touch_thread_hdl, &value_ptr);
 }
 
-void mug_stop_touch_thread()
+void mug_stop_touch_thread(handle_t handle)
 {
   int err = pthread_cancel(touch_thread_hdl);
 
@@ -17,6 +17,7 @@ CImg<unsigned char> canvas(SCREEN_WIDTH, SCREEN_HEIGHT, 1, 3, 0);
 #define BAR_NUM 10
 #define BAR_STEP (100 / BAR_NUM)
 #define INTERVAL 1000
+#define SMOOTH_TAU 20000
 
 handle_t disp_handle;
 handle_t battery_handle;
@@ -157,6 +158,7 @@ int main(int argc, char** argv)
 #endif
   disp_handle = mug_disp_init();
   battery_handle = mug_battery_init();
+  mug_battery_smooth(battery_handle, SMOOTH_TAU);
 
   mug_battery_on(battery_handle, on_battery, INTERVAL);
   mug_run_battery_watcher(battery_handle);
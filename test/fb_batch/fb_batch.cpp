@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <iohub_client.h>
+#include <mug.h>
+
+// in-process stand-in for the mcu frame buffer
+static unsigned char fake_fb[COMPRESSED_SIZE];
+static int transactions = 0;
+
+mug_error_t fake_i2c(handle_t handle, int cmd, char *data, int len)
+{
+  unsigned char *p = (unsigned char*)data;
+
+  MUG_ASSERT(len <= 32, "block too large: %d\n", len);
+  transactions++;
+
+  if(cmd == FB_BATCH_CMD) {
+    int mask = p[0] | (p[1] << 8);
+    unsigned char *content = p + FB_BATCH_HEADER;
+
+    for(int row = 0; row < MAX_COMPRESSED_ROWS; row++) {
+      if(!(mask & (1 << row)))
+        continue;
+      MUG_ASSERT(content + MAX_COMPRESSED_COLS <= p + len, "short batch\n");
+      memcpy(fake_fb + row * MAX_COMPRESSED_COLS, content, MAX_COMPRESSED_COLS);
+      content += MAX_COMPRESSED_COLS;
+    }
+  } else if(cmd == IOHUB_CMD_FB) {
+    memcpy(fake_fb + p[0] * MAX_COMPRESSED_COLS, p + 3, MAX_COMPRESSED_COLS);
+  } else {
+    MUG_ASSERT(false, "unexpected cmd %d\n", cmd);
+  }
+
+  return MUG_ERROR_NONE;
+}
+
+void run(handle_t handle, const char *name)
+{
+  char *frame = mug_create_raw_buffer();
+
+  transactions = 0;
+
+  for(int i = 0; i < 100; i++) {
+    for(int j = 0; j < COMPRESSED_SIZE; j++) {
+      // change a few rows per frame
+      frame[j] = (j / MAX_COMPRESSED_COLS) % (i % 5 + 1) ? frame[j] : rand() & 0x77;
+    }
+    mug_disp_raw(handle, frame);
+    MUG_ASSERT(memcmp(frame, fake_fb, COMPRESSED_SIZE) == 0, "%s: frame %d mismatch\n", name, i);
+  }
+
+  printf("%s: %d transactions for 100 frames\n", name, transactions);
+
+  mug_free_raw_buffer(frame);
+}
+
+// the shared frame buffer copy now holds the fake panel, not the real one
+void release_shared_fb(int sig)
+{
+  mug_disp_invalidate(0);
+
+  if(sig != 0) {
+    signal(sig, SIG_DFL);
+    raise(sig);
+  }
+}
+
+int main()
+{
+  handle_t handle = 0;
+
+  mug_disp_set_transport(fake_i2c);
+  signal(SIGABRT, release_shared_fb);
+  signal(SIGINT, release_shared_fb);
+
+  // the first frame is sent in full, which syncs the fake device
+  mug_disp_invalidate(handle);
+
+  mug_disp_set_batch(handle, 0);
+  run(handle, "row");
+
+  MUG_ASSERT(mug_disp_set_batch(handle, 1) == 0, "batching refused\n");
+  run(handle, "batch");
+
+  release_shared_fb(0);
+
+  return 0;
+}
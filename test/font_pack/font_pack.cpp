@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mug.h>
+#include <utf8.h>
+#include <font_pack.h>
+#include <pack.h>
+
+#include <set>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "ft2build.h"
+#include FT_FREETYPE_H
+
+#define DEFAULT_HEIGHT 12
+
+typedef struct _packed_glyph_t {
+  font_pack_glyph_t     index;
+  vector<unsigned char> bitmap;
+} packed_glyph_t;
+
+bool read_chars(const char *fname, set<unsigned int> &codes)
+{
+  FILE *fp = fopen(fname, "r");
+  if(fp == NULL)
+    return false;
+
+  string text;
+  char buf[1024];
+  size_t len;
+
+  while((len = fread(buf, 1, sizeof(buf), fp)) > 0)
+    text.append(buf, len);
+
+  fclose(fp);
+
+  vector<unsigned int> unicode;
+  if(!utf8_to_unicode_uint(text, unicode))
+    return false;
+
+  for(int i = 0; i < unicode.size(); i++) {
+    if(unicode[i] > ' ')
+      codes.insert(unicode[i]);
+  }
+
+  return true;
+}
+
+// same threshold as drawing white text on black and latching it
+void pack_glyph(FT_Bitmap *bitmap, packed_glyph_t *glyph)
+{
+  int pitch = FONT_PACK_PITCH(bitmap->width);
+
+  glyph->index.width = bitmap->width;
+  glyph->index.rows = bitmap->rows;
+  glyph->bitmap.assign(pitch * bitmap->rows, 0);
+
+  for(int y = 0; y < bitmap->rows; y++) {
+    for(int x = 0; x < bitmap->width; x++) {
+      unsigned char v = bitmap->buffer[y * bitmap->width + x];
+      unsigned char pixel = (v / 255.0f) * v;
+      if(pixel > LATCH)
+        glyph->bitmap[y * pitch + x / 8] |= 0x80 >> (x % 8);
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if(argc < 4) {
+    printf("%s font.ttf chars.txt output.mfp [height]\n", argv[0]);
+    return 0;
+  }
+
+  int height = argc > 4 ? atoi(argv[4]) : DEFAULT_HEIGHT;
+
+  // printable ascii is always included, 'a' also gives the space width
+  set<unsigned int> codes;
+  for(unsigned int c = '!'; c <= '~'; c++)
+    codes.insert(c);
+
+  MUG_ASSERT(read_chars(argv[2], codes), "can not read %s\n", argv[2]);
+
+  FT_Library ftlib;
+  FT_Face face;
+
+  MUG_ASSERT(!FT_Init_FreeType(&ftlib), "can not init freetype\n");
+  MUG_ASSERT(!FT_New_Face(ftlib, argv[1], 0, &face), "can not load font %s\n", argv[1]);
+  FT_Set_Pixel_Sizes(face, 0, height);
+
+  vector<packed_glyph_t> glyphs;
+  packed_glyph_t glyph;
+
+  for(set<unsigned int>::iterator itr = codes.begin(); itr != codes.end(); itr++) {
+    if(FT_Load_Char(face, *itr, FT_LOAD_RENDER)) {
+      printf("skip U+%04x\n", *itr);
+      continue;
+    }
+
+    memset(&glyph.index, 0, sizeof(glyph.index));
+    glyph.index.code = *itr;
+    pack_glyph(&(face->glyph->bitmap), &glyph);
+    glyphs.push_back(glyph);
+  }
+
+  font_pack_header_t header;
+  header.magic = FONT_PACK_MAGIC;
+  header.version = FONT_PACK_VERSION;
+  header.height = height;
+  header.count = glyphs.size();
+
+  uint32_t offset = sizeof(header) + glyphs.size() * sizeof(font_pack_glyph_t);
+  for(int i = 0; i < glyphs.size(); i++) {
+    glyphs[i].index.offset = offset;
+    offset += glyphs[i].bitmap.size();
+  }
+
+  FILE *fp = fopen(argv[3], "wb");
+  MUG_ASSERT(fp != NULL, "can not create %s\n", argv[3]);
+
+  fwrite(&header, sizeof(header), 1, fp);
+  for(int i = 0; i < glyphs.size(); i++)
+    fwrite(&glyphs[i].index, sizeof(font_pack_glyph_t), 1, fp);
+  for(int i = 0; i < glyphs.size(); i++)
+    if(!glyphs[i].bitmap.empty())
+      fwrite(&glyphs[i].bitmap[0], 1, glyphs[i].bitmap.size(), fp);
+
+  fclose(fp);
+
+  FT_Done_Face(face);
+  FT_Done_FreeType(ftlib);
+
+  printf("generated: %s, %d glyphs, %d bytes\n", argv[3], (int)glyphs.size(), offset);
+  return 0;
+}
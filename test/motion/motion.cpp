@@ -2,6 +2,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <mug.h>
 #include <CImg.h>
 using namespace cimg_library;
@@ -63,6 +64,28 @@ void on_angle(float angle_x, float angle_y, float angle_z)
   printf("[ %f, %f, %f ]\n", angle_x, angle_y, angle_z);
 }
 
+#define BATCH_RATE    400   // Hz
+#define BATCH_SIZE    40
+#define BATCH_LATENCY 100   // ms
+
+static mug_fusion_t fusion;
+
+void on_batch(motion_sample_t *samples, int n)
+{
+  motion_data_t data[BATCH_SIZE];
+  mug_attitude_t att;
+
+  for(int i = 0; i < n; i++)
+    data[i] = samples[i].data;
+
+  mug_fusion_update(&fusion, data, n, 1.0f / BATCH_RATE, NULL);
+  mug_fusion_attitude(&fusion, &att);
+
+  printf("%3d samples over %5lld us, roll %7.2f pitch %7.2f yaw %7.2f, dropped %u\n",
+         n, samples[n - 1].stamp - samples[0].stamp, att.roll, att.pitch, att.yaw,
+         mug_motion_dropped(motion_handle));
+}
+
 void on_touch(int x, int y, int id)
 {
   printf("(%d, %d, %d)\n", x, y, id);
@@ -78,6 +101,15 @@ int main(int argc, char** argv)
 {
 
   init();
+
+  // motion -b: sample at BATCH_RATE and fuse batches
+  if(argc > 1 && strcmp(argv[1], "-b") == 0) {
+    mug_fusion_init(&fusion);
+    mug_set_motion_rate(motion_handle, BATCH_RATE);
+    mug_motion_batch_on(motion_handle, on_batch, BATCH_SIZE, BATCH_LATENCY);
+    mug_run_motion_watcher(motion_handle);
+    return 0;
+  }
   
 #if 1  
   mug_motion_on(motion_handle, on_motion);
@@ -1,14 +1,28 @@
 #include <stdio.h>
+#include <string.h>
 #include <mug.h>
 
 char frames[] = {0,16,1,0,1,0,0,1,17,17,17,17,17,17,0,1,0,16,1,0,1,0,17,1,0,0,0,1,0,0,17,17,0,17,17,17,17,0,1,1,0,1,16,1,16,0,0,17,0,1,16,1,16,0,17,17,17,17,17,17,17,17,1,1,0,0,16,1,0,0,0,1,0,16,1,16,1,0,0,1,16,17,0,0,17,17,0,1,16,0,0,0,0,0,0,1,16,1,0,1,0,0,1,0,17,17,17,17,17,0,1,0,16,1,0,1,0,17,1,16,0,0,1,0,0,17,17,0,17,17,17,17,0,1,1,17,1,16,1,16,0,0,17,0,1,16,1,16,0,17,17,17,17,17,17,17,17,1,1,16,0,16,1,0,0,0,1,16,16,1,16,1,0,0,1,0,17,0,0,17,17,0,1,0,0,0,0,0,0,0,1,0,1,0,1,0,0,1,0,16,17,17,17,17,0,1,0,16,1,0,1,0,17,1,16,17,0,1,0,0,17,17,0,16,17,17,17,0,1,1,17,17,16,1,16,0,0,17,0,0,16,1,16,0,17,17,17,17,17,17,17,17,1,1,16,0,16,1,0,0,0,1,16,1,1,16,1,0,0,1,0,0,0,0,17,17,0,1,0,16,0,0,0,0,0,1,0,0,0,1,0,0,1,0,16,0,17,17,17,0,1,0,16,0,0,1,0,17,1,16,17,17,1,0,0,17,17,0,16,0,17,17,0,1,1,17,17,17,1,16,0,0,17,0,0,16,1,16,0,17,17,17,17,17,17,17,17,1,1,16,0,16,1,0,0,0,1,16,1,16,16,1,0,0,1,0,0,16,0,17,17,0,1,0,16,17,0,0,0,0,1,0,0,0,1,0,0,1,0,16,0,0,17,17,0,1,0,16,0,0,1,0,17,1,16,17,17,1,0,0,17,17,0,16,0,0,17,0,1,1,17,17,17,17,16,0,0,17,0,0,16,0,16,0,17,17,17,17,17,17,17,17,1,1,16,0,16,0,0,0,0,1,16,1,16,0,1,0,0,1,0,0,16,0,17,17,0,1,0,16,17,0,0,0,0,1,0,0,0,0,0,0,1,0,16,0,0,0,17,0,1,0,16,0,0,0,0,17,1,16,17,17,1,0,0,17,17,0,16,0,0,16,0,1,1,17,17,17,17,17,0,0,17,0,0,16,0,0,0,17,17,17,17,17,17,0,17,1,1,16,0,16,0,0,0,0,1,16,1,16,0,16,0,0,1,0,0,16,0,16,17,0,1,0,16,17,0,0,0,0,1,0,0,0,0,0,0,1,0,16,0,0,0,16,0,1,0,16,0,0,0,16,17,1,16,17,17,1,0,17,17,17,0,16,0,0,16,1,1,1,17,17,17,17,17,0,0,17,0,0,16,0,0,16,17,17,17,17,17,17,0,17,1,1,16,0,16,0,0,1,0,1,16,1,16,0,16,0,0,1,0,0,16,0,16,0,0,1,0,16,17,0,0,16,0,1,0,0,0,0,0,0,1,0,16,0,0,0,16,0,1,0,16,0,0,0,16,0,1,16,17,17,1,0,17,17,17,0,16,0,0,16,1,0,1,17,17,17,17,17,0,0,17,0,0,16,0,0,16,0,17,17,17,17,17,0,17,0,1,16,0,16,0,0,1,0,1,16,1,16,0,16,0,0,1,0,0,16,0,16,0,0,1,0,16,17,0,0,16,17,1,0,0,0,0,0,0,0,0,16,0,0,0,16,0,0,0,16,0,0,0,16,0,0,16,17,17,1,0,17,17,17,0,16,0,0,16,1,0,1,17,17,17,17,17,0,0,1,0,0,16,0,0,16,0,1,17,17,17,17,0,17,0,1,16,0,16,0,0,1,0,1,16,1,16,0,16,0,0,1,0,0,16,0,16,0,0,1,0,16,17,0,0,16,17,0,0,0,0,0,0,0,0,0,16,0,0,0,16,0,0,0,16,0,0,0,16,0,0,0,17,17,1,0,17,17,17,17,16,0,0,16,1,0,1,0,17,17,17,17,0,0,1,0,0,16,0,0,16,0,1,1,17,17,17,0,17,0,1,16,0,16,0,0,1,0,1,16,1,16,0,16,0,0,1,0,0,16,0,16,0,0,1,0,16,17,0,0,16,17,0,0,0,0,0,0,0,0,0,0,0,0,0,16,0,0,0,0,0,0,0,16,0,0,0,0,17,1,0,17,17,17,17,17,0,0,16,1,0,1,0,1,17,17,17,0,0,1,0,0,16,0,0,16,0,1,1,0,17,17,0,17,0,1,16,0,16,0,0,1,0,1,16,1,16,0,16,0,0,1,0,1,16,0,16,0,0,1,0,0,17,0,0,16,17,0,0,0,0,0,0,0,0,0,0,0,0,0,16,0,0,0,0,17,0,0,16,0,0,0,0,16,1,0,17,17,17,17,17,16,0,16,1,0,1,0,1,16,17,17,0,0,1,0,0,16,0,0,16,0,1,1,0,16,17,0,17,0,1,16,0,16,0,0,1,0,1,16,1,16,0,16,0,0,1,0,1,16,0,16,0,0,1,0,0,17,0,0,16,17,0,0,0,0,0,0,0,0,0,0,0,0,0,16,0,0,0,0,17,1,0,16,0,0,0,0,16,0,0,17,17,17,17,17,16,0,16,1,0,1,0,1,16,0,17,0,0,1,0,0,16,0,0,16,0,1,1,0,16,0,0,17,0,1,16,0,16,0,0,1,0,1,16,1,16,0,16,0,0,1,0,1,16,0,16,0,0,1,0,0,17,1,0,16,17,0,0,0,0,0,0,0,0,0,0,0,0,0,16,0,0,0,0,17,1,16,16,0,0,0,0,16,0,16,17,17,17,17,17,16,0,16,1,0,1,0,1,16,0,16,0,0,1,0,0,16,0,16,16,0,1,1,0,16,0,16,17,0,1,16,0,16,0,16,1,0,1,16,1,16,0,16,0,0,1,0,1,16,0,16,0,0,1,0,0,17,1,16,16,17,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,17,1,16,0,0,0,0,0,16,0,16,0,17,17,17,17,16,0,16,0,0,1,0,1,16,0,16,0,0,1,0,0,16,0,16,0,0,1,1,0,16,0,16,0,0,1,16,0,16,0,16,0,0,1,16,1,16,0,16,0,0,1,0,1,16,0,16,1,0,1,0,0,17,1,16,17,17,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,17,1,16,0,0,0,0,0,16,0,16,0,0,17,17,17,16,0,16,0,0,1,0,1,16,0,16,0,0,1,0,0,16,0,16,0,0,1,1,0,16,0,16,0,0,1,16,0,16,0,16,0,0,1,16,1,16,0,16,0,0,1,0,1,16,0,16,1,0,1,0,0,17,1,16,17,17,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,17,1,16,0,0,0,0,0,16,0,16,0,0,0,17,17,16,0,16,0,0,16,0,1,16,0,16,0,0,16,0,0,16,0,16,0,0,16,1,0,16,0,16,0,0,16,16,0,16,0,16,0,0,16,16,1,16,0,16,0,0,16,0,1,16,0,16,1,0,0,0,0,17,1,16,17,17,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,17,1,16,0,0,0,16,0,16,0,16,0,0,0,17,17,16,0,16,0,0,16,1,1,16,0,16,0,0,16,0,0,16,0,16,0,0,16,0,0,16,0,16,0,0,16,0,0,16,0,16,0,0,16,0,1,16,0,16,0,0,16,1,1,16,0,16,1,0,0,17,0,17,1,16,17,17,0,16,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,17,1,16,0,0,0,16,17,16,0,16,0,0,0,17,0,16,0,16,0,0,16,1,0,16,0,16,0,0,16,0,0,16,0,16,0,0,16,0,0,16,0,16,0,0,16,0,0,16,0,16,0,0,16,0,0,16,0,16,0,0,16,1,0,16,0,16,1,0,0,17,0,17,1,16,17,17,0,16,17,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,16,0,0,0,16,17,1,0,16,0,0,0,17,0,0,0,16,0,0,16,1,0,0,0,16,0,0,16,0,0,0,0,16,0,0,16,0,0,0,0,16,0,0,16,0,0,0,0,16,0,0,16,0,0,0,0,16,0,0,16,1,0,0,0,16,1,0,0,17,0,0,1,16,17,17,0,16,17,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,16,0,0,0,16,17,1,0,16,0,0,0,17,0,0,17,16,0,0,16,1,0,0,0,16,0,0,16,0,0,0,0,16,0,0,16,0,0,0,0,16,0,0,16,0,0,0,0,16,0,0,16,0,0,0,0,16,0,0,16,1,0,0,17,16,1,0,0,17,0,0,0,16,17,17,0,16,17,1,0,0,0,0,0,0,0,0,16,0,0,0,0,0,0,0,16,0,0,0,16,17,1,0,16,0,0,0,17,0,0,17,17,0,0,16,1,0,0,0,16,0,0,16,0,0,0,0,0,0,0,16,0,0,0,0,17,0,0,16,0,0,0,0,1,0,0,16,0,0,0,0,1,0,0,16,1,0,0,17,17,1,0,0,17,0,0,0,0,17,17,0,16,17,1,0,16,0,0,0,0,0,0,16,17,0,0,0,0,0,0,16,0,0,0,16,17,1,0,16,1,0,0,17,0,0,17,17,17,0,16,1,0,0,0,16,1,0,16,0,0,0,0,0,0,0,16,0,0,0,0,17,17,0,16,0,0,0,0,1,16,0,16,0,0,0,0,1,16,0,16,1,0,0,17,17,17,0,0,17,0,0,0,0,16,17,0,16,17,1,0,16,1,0,0,0,0,0,16,17,0,0,0,0,0,0,16,0,0,0,16,17,1,0,16,1,0,0,17,0,0,17,17,17,17,16,1,0,0,0,16,1,0,16,0,0,0,0,0,0,1,16,0,0,0,0,17,17,17,16,0,0,0,0,1,16,1,16,0,0,0,0,1,16,1,16,1,0,0,17,17,17,17,0,17,0,0,0,0,16,1,0,16,17,1,0,16,1,16,0,0,0,0,16,17,0,0,0,0,0,0,16,0,0,0,16,17,1,0,16,1,0,1,17,0,0,17,17,17,17,17,1,0,0,0,16,1,0,1,0,0,0,0,0,0,1,0,0,0,0,0,17,17,17,17,0,0,0,0,1,16,1,16,0,0,0,0,1,16,1,16,1,0,0,17,17,17,17,17,17,0,0,0,0,16,1,0,16,17,1,0,16,1,16,1,0,0,0,16,17,0,0,17,0,0,0,16,0,0,0,0,17,1,0,16,1,0,1,0,0,0,17,17,17,17,17,17,0,0,0,16,1,0,1,0,0,0,0,0,0,1,0,0,0,0,0,17,17,17,17,0,0,0,0,1,16,1,16,0,0,0,0,1,16,1,16,0,0,0,17,17,17,17,17,17,0,0,0,0,16,1,0,0,17,1,0,16,1,16,1,0,0,0,16,17,0,0,17,17,0,0,16,0,0,0,0,0,1,0,16,1,0,1,0,0,0,17,17,17,17,17,17,0,0,0,16,1,0,1,0,17,0,0,0,0,1,0,0,17,0,0,17,17,17,17,0,1,0,0,1,16,1,16,0,0,0,0,1,16,1,16,0,17,0,17,17,17,17,17,17,1,0,0,0,16,1,0,0,0,1,0,16,1,16,1,0,0,0,16,17,0,0,17,17,0,0,16,0,0,0,0,0,0};
 
-int main()
+int main(int argc, char** argv)
 {
   handle_t handle = mug_disp_init();
+  int num = sizeof(frames)/COMPRESSED_SIZE;
+
+  // -u: upload frames once and let mcu play them
+  if(argc > 1 && strcmp(argv[1], "-u") == 0) {
+    int durations[num];
+    for(int i = 0; i < num; i++)
+      durations[i] = 200;
+
+    mug_upload_animation(handle, frames, num, durations);
+    mug_play_uploaded(handle);
+    mug_close(handle);
+    return 0;
+  }
 
   while(1) {
-    mug_disp_raw_N(handle, frames, sizeof(frames)/COMPRESSED_SIZE, 200);
+    mug_disp_raw_N(handle, frames, num, 200);
   }
 
   mug_close(handle); 
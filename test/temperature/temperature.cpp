@@ -11,6 +11,7 @@ CImg<unsigned char> canvas(SCREEN_WIDTH, SCREEN_HEIGHT, 1, 3, 0);
 
 #define WARM 30
 #define HOT  50
+#define SAMPLES 5    // per second, filtered before redrawing
 
 handle_t disp_handle;
 handle_t temp_handle;
@@ -48,6 +49,7 @@ int main(int argc, char** argv)
   disp_handle = mug_disp_init();
   temp_handle = mug_temp_init();
 
+  mug_config_adc_filter(temp_handle, SAMPLES, 0, 0);
   mug_temp_on(temp_handle, on_temp, 1000);
   mug_run_temp_watcher(temp_handle);
 
@@ -0,0 +1,212 @@
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <linux/input.h>
+#include <mug.h>
+#include <touch_rec.h>
+#include <mono_time.h>
+
+#include <vector>
+using namespace std;
+
+// replay a session saved with mug_touch_record through a pipe
+//
+//   touch_replay [-f] record
+//
+// events keep their recorded spacing unless -f is given, in which case
+// they are written as fast as the parser takes them
+
+#define IDLE_WAIT_MS 300   // longer than the touch idle timeout
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static volatile int allocs = 0;
+
+extern "C" void *malloc(size_t size)
+{
+  __sync_fetch_and_add(&allocs, 1);
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+  __sync_fetch_and_add(&allocs, 1);
+  return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+  __sync_fetch_and_add(&allocs, 1);
+  return __libc_realloc(ptr, size);
+}
+
+static vector<input_event> events;
+static bool fast = false;
+static int pipe_fd[2];
+static handle_t handle;
+
+static long long ts_to_us(const struct timeval *tv)
+{
+  return tv->tv_sec * 1000000LL + tv->tv_usec;
+}
+
+static void sleep_until_us(long long deadline)
+{
+  struct timespec ts;
+  ts.tv_sec = deadline / 1000000;
+  ts.tv_nsec = (deadline % 1000000) * 1000;
+
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+bool load_record(const char *path)
+{
+  touch_rec_header_t header;
+  input_event ev;
+
+  FILE *fp = fopen(path, "rb");
+  if(fp == NULL) {
+    printf("can not open %s\n", path);
+    return false;
+  }
+
+  if(fread(&header, sizeof(header), 1, fp) != 1
+     || header.magic != TOUCH_REC_MAGIC
+     || header.version != TOUCH_REC_VERSION
+     || header.event_size != sizeof(input_event)) {
+    printf("%s is not a touch record of this platform\n", path);
+    fclose(fp);
+    return false;
+  }
+
+  while(fread(&ev, sizeof(ev), 1, fp) == 1)
+    events.push_back(ev);
+
+  fclose(fp);
+
+  return !events.empty();
+}
+
+// write one EV_SYN terminated packet per wakeup, stamped with the time
+// it is written so the library measures latency from here
+void replay()
+{
+  long long base = ts_to_us(&events[0].time);
+  long long start = now_us();
+  int first = 0;
+
+  for(int i = 0; i < events.size(); i++) {
+    bool packet_end = events[i].type == EV_SYN && events[i].code == SYN_REPORT;
+    if(!packet_end && i != events.size() - 1)
+      continue;
+
+    if(!fast)
+      sleep_until_us(start + ts_to_us(&events[first].time) - base);
+
+    long long stamp = now_us();
+    for(int j = first; j <= i; j++) {
+      events[j].time.tv_sec = stamp / 1000000;
+      events[j].time.tv_usec = stamp % 1000000;
+    }
+
+    const char *p = (const char*)&events[first];
+    size_t len = (i - first + 1) * sizeof(input_event);
+    while(len > 0) {
+      ssize_t n = write(pipe_fd[1], p, len);
+      if(n < 0 && errno == EINTR)
+        continue;
+      MUG_ASSERT(n > 0, "replay write failed\n");
+      p += n;
+      len -= n;
+    }
+
+    first = i + 1;
+  }
+}
+
+void* replay_entry(void *arg)
+{
+  touch_stat_t stat;
+
+  mug_touch_reset_stat(handle);
+  int allocs_start = allocs;
+  long long start = now_us();
+
+  replay();
+
+  // wait for the parser to catch up
+  do {
+    usleep(1000);
+    mug_touch_get_stat(handle, &stat);
+  } while(stat.events < events.size());
+
+  long long elapsed = now_us() - start;
+
+  // let the touch end so up/click callbacks are counted
+  usleep(IDLE_WAIT_MS * 1000);
+
+  int allocs_used = allocs - allocs_start;
+  mug_touch_get_stat(handle, &stat);
+
+  printf("events:          %d\n", stat.events);
+  printf("events/s:        %.0f\n", stat.events * 1000000.0 / elapsed);
+  printf("callbacks:       %d\n", stat.callbacks);
+  printf("latency p50:     %d us\n", stat.p50_latency);
+  printf("latency p99:     %d us\n", stat.p99_latency);
+  printf("latency max:     %d us\n", stat.max_latency);
+  printf("allocs/event:    %.3f\n", (double)allocs_used / stat.events);
+  printf("dropped:         %u\n", mug_touch_dropped(handle));
+
+  exit(0);
+
+  return NULL;
+}
+
+void on_touch(int x, int y, int id)
+{
+}
+
+void on_touch_event(touch_event_t e, int x, int y, int id)
+{
+}
+
+void on_gesture(gesture_t g, char *info)
+{
+}
+
+int main(int argc, char **argv)
+{
+  int opt;
+
+  while((opt = getopt(argc, argv, "f")) != -1) {
+    if(opt == 'f')
+      fast = true;
+  }
+
+  if(optind >= argc) {
+    printf("usage: %s [-f] record\n", argv[0]);
+    return 1;
+  }
+
+  if(!load_record(argv[optind]))
+    return 1;
+
+  MUG_ASSERT(pipe(pipe_fd) == 0, "can not create pipe\n");
+
+  handle = mug_touch_init_fd(pipe_fd[0]);
+  mug_touch_on(handle, on_touch);
+  mug_touch_event_on(handle, TOUCH_EVENT_ALL, on_touch_event);
+  mug_gesture_on(handle, MUG_GESTURE, on_gesture);
+
+  pthread_t hdl;
+  MUG_ASSERT(!pthread_create(&hdl, NULL, replay_entry, NULL), "can not create replay thread\n");
+
+  mug_run_touch_thread(handle);
+  mug_wait_for_touch_thread(handle);
+}
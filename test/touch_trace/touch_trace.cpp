@@ -2,6 +2,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <mug.h>
 #include <CImg.h>
 using namespace cimg_library;
@@ -69,10 +70,15 @@ void init()
   memset(last, -1, sizeof(last));
 }
 
-int main()
+// touch_trace [-r record] saves the session for test/touch_replay
+int main(int argc, char **argv)
 {
   // init
   touch_handle = mug_touch_init();
+
+  if(argc > 2 && strcmp(argv[1], "-r") == 0)
+    mug_touch_record(touch_handle, argv[2]);
+
   disp_handle = mug_disp_init();
   init();
 